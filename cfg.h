@@ -27,10 +27,95 @@
   #error Select a valid Board Mode!
 #endif
 
+// MCLK and SMCLK frequency in Hz: 16000000 or 24000000, every baud, timer and tune constant follows
+#define MCLK_FREQ 16000000
+
 // Set DAC reference
-#define DAC_REF_1V5 1.5
-#define DAC_REF_2V0 2.0
-#define DAC_REF_2V5 2.5
+#define DAC_REF_1V5 1500   // mV, integer so it can be tested with #if
+#define DAC_REF_2V0 2000
+#define DAC_REF_2V5 2500
 #define DAC_REF DAC_REF_2V5
 
+// MIDI THRU on UCA0 TX (P1.7)
+#define MIDI_THRU_OFF      0    // UCA0 TX unused
+#define MIDI_THRU_ALL      1    // forward every received byte
+#define MIDI_THRU_OTHER_CH 2    // forward everything except channel messages on midi_channel
+#define MIDI_THRU          MIDI_THRU_OFF
+
+// MIDI merge: 1=UCA1 becomes a second MIDI input at 31250 baud, 0=UCA1 is the debug UART
+#define MIDI_MERGE 0
+
+// Background retune of the EXP FREQ offset while playing: 1=On, 0=Off
+#define BG_RETUNE 1
+
+// Frequency locked loop trimming the pitch DAC while a note is held: 1=On, 0=Off (needs BG_RETUNE)
+#define PITCH_FLL 0
+
+// ADSR envelope on DAC3 (P3.5) from the TB3 control tick: 1=On, 0=Off
+#define ENV_OUT 0
+
+// Gate on P6.0 and retrigger pulse on P6.1 from TB3 compare outputs: 1=On, 0=Off
+#define GATE_OUT 0
+
+// Trigger pulse width in microseconds, 10 to 2000
+#define TRIG_WIDTH_US 1000
+
+// Note output a fixed delay after the MIDI message on TB3 CCR3, constant latency instead of main loop jitter: 1=On, 0=Off
+#define NOTE_SCHED 0
+
+// Delay from a note message to its output in microseconds, 100 to 1300
+#define SCHED_DELAY_US 1000
+
+// Fine pitch DAC on DAC3 (P3.5) summed into the pitch CV by the VCO board, calibrated after each tune: 1=On, 0=Off
+#define PITCH_FINE_DAC 0
+
+// CV input on P1.2 (A2), 0 to 10 V scaled to 0 to DAC_REF by the board, quantized to the preset scale: 1=On, 0=Off
+#define CV_IN 0
+
+// Pitch to MIDI: the oscillator on P2.2 (TB1CLK) tracked while playing, NOTE ON/OFF and bend sent on UCA0 TX: 1=On, 0=Off (needs BG_RETUNE 0)
+#define PITCH_TRACK 0
+
+// Flight recorder, event trace ring in FRAM: 1=On, 0=Off
+#define FLIGHT_TRACE 1
+
+// MIDI input stress run over the UCA0 loopback, started with 's' on the debug terminal: 1=On, 0=Off
+#define MIDI_STRESS 0
+
+// Pitch verification sweep of every note after each full tune and on 'v' from the debug terminal: 1=On, 0=Off
+#define PITCH_VERIFY 0
+
+// MIDI RX interrupt, parser and note-on pitch path copied to RAM at boot, no FRAM wait states: 1=On, 0=Off
+#define RAM_HOT_PATH 0
+
+// CPU cycles of the MIDI RX interrupt and the note-on path counted on TB3R, printed with 'p' on the debug terminal: 1=On, 0=Off
+#define CYCLE_PROFILE 0
+
+#if PITCH_FLL == 1 && BG_RETUNE == 0
+  #error PITCH_FLL runs inside the background retune service, set BG_RETUNE to 1
+#endif
+
+#if PITCH_FINE_DAC == 1 && ENV_OUT == 1
+  #error PITCH_FINE_DAC and ENV_OUT both need DAC3, set ENV_OUT to 0
+#endif
+
+#if PITCH_TRACK == 1 && (BG_RETUNE == 1 || MIDI_STRESS == 1)
+  #error PITCH_TRACK takes the frequency counter and UCA0 TX, set BG_RETUNE 0 and MIDI_STRESS 0
+#endif
+
+#if MIDI_MERGE == 1 && DEBUG == 1
+  #error MIDI_MERGE takes over the debug UART, set DEBUG to 0
+#endif
+
+#if MIDI_STRESS == 1 && (DEBUG == 0 || MIDI_MERGE == 1 || MIDI_THRU != MIDI_THRU_OFF)
+  #error MIDI_STRESS sends on UCA0 TX and reports on the debug UART, set DEBUG 1, MIDI_MERGE 0 and MIDI_THRU_OFF
+#endif
+
+#if PITCH_VERIFY == 1 && DEBUG == 0
+  #error PITCH_VERIFY reports on the debug UART, set DEBUG to 1
+#endif
+
+#if CYCLE_PROFILE == 1 && DEBUG == 0
+  #error CYCLE_PROFILE reports on the debug UART, set DEBUG to 1
+#endif
+
 #endif /* CFG_H_ */
@@ -0,0 +1,115 @@
+/*
+ * cv.c
+ *
+ * The CV input plays the VCO from a sequencer. The board scales 0 to 10 V
+ * down to 0 to DAC_REF on P1.2 like the pitch output scales up, so an ADC
+ * code per semitone is the same DAC_Q4_PER_NOTE as on the pitch DAC.
+ *
+ * There is no DMA on the FR2355. The ADC has its own interrupt (ADCIE0 on
+ * ADC_VECTOR), but a sample per control tick is all the filter needs, so the
+ * tick polls instead: it starts a conversion and, one tick later, drops its
+ * result into a ring, a register read and a write per sample, without
+ * another interrupt to fit into the MIDI RX latency budget. The main loop
+ * drains the ring through a one pole low pass in 1/16 code fixed point
+ * whenever it gets to it.
+ *
+ * The quantizer snaps the filtered CV to the notes of the preset's cv_scale.
+ * The boundaries between neighbouring notes of the scale are worked out once
+ * per scale, and the note only moves once the CV is CV_HYST past one, so a
+ * noisy CV sitting on a boundary does not flip between two notes. The walk
+ * starts from the last note, a sample costs a compare or two.
+ *
+ */
+
+#include <cv.h>
+#include <mcu_vco.h>
+#include <preset.h>
+
+#if CV_IN == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned char cv_note = 0;
+unsigned int cv_drops = 0;
+
+static unsigned int ring[SIZE_CV_RING];
+static volatile unsigned char ring_head = 0;    // next free slot, free running
+static unsigned char ring_tail = 0;             // oldest sample
+
+static unsigned int  filt = 0;                  // filtered CV in 1/16 ADC code
+static unsigned int  table_scale = 0;           // scale the tables hold, 0 before the first build
+static unsigned char num_notes;                 // notes of the scale up to CV_LAST_NOTE
+static unsigned char scale_note[CV_LAST_NOTE + 1];
+static unsigned int  upper[CV_LAST_NOTE + 1];   // boundary to the next note up, 1/16 ADC code
+static unsigned char pos = 0;                   // index of cv_note in scale_note
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Collect the last conversion and start the next, from the TB3 CCR0 interrupt
+void cvTick(void)
+{
+    if (ADCIFG & ADCIFG0)
+    {
+        if ((unsigned char)(ring_head - ring_tail) == SIZE_CV_RING) cv_drops++;
+        else ring[ring_head++ & CV_RING_MASK] = ADCMEM0;   // also clears ADCIFG0
+    }
+    ADCCTL0 |= ADCSC;
+}
+
+
+// Boundary tables of a scale, bit n of scale set if pitch class n (0 = C) is in it
+static void cvBuild(unsigned int scale)
+{
+    unsigned char n;
+
+    num_notes = 0;
+    for (n = 0; n <= CV_LAST_NOTE; n++)
+    {
+        if (scale & (1u << (n % 12))) scale_note[num_notes++] = n;
+    }
+
+    // halfway between neighbours, the top note has no boundary above it
+    for (n = 0; n + 1 < num_notes; n++)
+    {
+        upper[n] = (unsigned int)(((unsigned long)(scale_note[n] + scale_note[n + 1]) * DAC_Q4_PER_NOTE) >> 1);
+    }
+    upper[num_notes - 1] = 0xFFFF;
+
+    table_scale = scale;
+    pos = 0;
+}
+
+
+// Filter and quantize the new samples, 1 if cv_note changed
+unsigned char cvService(void)
+{
+    unsigned int scale = preset->cv_scale & CV_SCALE_ALL;
+    unsigned char last = cv_note;
+
+    if (scale == 0) scale = CV_SCALE_ALL;
+    if (scale != table_scale) cvBuild(scale);
+
+    while (ring_tail != ring_head)
+    {
+        long x = (long)ring[ring_tail++ & CV_RING_MASK] << 4;
+
+        filt += (int)((x - (long)filt) >> CV_FILT_SHIFT);
+    }
+
+    // past the boundary plus the hysteresis, up or down
+    while (pos + 1 < num_notes && filt > upper[pos] + CV_HYST) pos++;
+    while (pos > 0 && filt < upper[pos - 1] - CV_HYST) pos--;
+
+    cv_note = scale_note[pos];
+    return cv_note != last;
+}
+
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * cv.h
+ *
+ * CV input on the ADC, filtered and quantized to the preset scale, CV_IN build only
+ *
+ */
+
+#ifndef CV_H_
+#define CV_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define SIZE_CV_RING        16                      // samples, must be a power of 2
+#define CV_RING_MASK        (SIZE_CV_RING - 1)
+#define CV_FILT_SHIFT       2                       // one pole low pass, 4 ms time constant at the control tick
+#define CV_LAST_NOTE        120                     // 10 V, the top of the input range
+#define CV_HYST             (DAC_Q4_PER_NOTE / 5)   // 20 cents past a boundary before the note changes
+#define CV_SCALE_ALL        0x0FFF                  // all 12 pitch classes
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned char cv_note;                   // quantized note of the CV input
+extern unsigned int cv_drops;                   // samples lost to a full ring
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void cvTick(void);                                      // Collect the last conversion and start the next, from the TB3 CCR0 interrupt
+unsigned char cvService(void);                          // Filter and quantize the new samples, 1 if cv_note changed
+
+
+#endif /* CV_H_ */
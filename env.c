@@ -0,0 +1,153 @@
+/*
+ * env.c
+ *
+ * The envelope runs from the TB3 control tick at CTRL_TICK_HZ. Each stage is
+ * a one-pole exponential segment: every tick the level moves a fixed fraction
+ * of the way to its target, taken from env_coef for the preset time. Attack
+ * aims ENV_OVERSHOOT above full scale and decay and release aim
+ * ENV_UNDERSHOOT below their end level, so every segment ends in a finite
+ * time like an analog ADSR instead of creeping up on its target.
+ *
+ * A tick is one 16x16 multiply and a few compares whatever the stage, so the
+ * cost is constant and the MIDI RX interrupt is never held up for long.
+ * Velocity scales the output with the preset velocity depth, and a note
+ * played while another is held restarts the attack from the current level
+ * unless the preset is set to legato. Channel pressure of the note that owns
+ * the output (MPE or plain aftertouch) lifts the velocity gain towards full
+ * scale.
+ *
+ */
+
+#include <env.h>
+#include <mcu_vco.h>
+#include <preset.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+volatile unsigned char env_stage = ENV_IDLE;
+
+static long env_level = 0;                  // 0 to ENV_FULL
+static unsigned int env_gain = 128;         // velocity gain in 1/128
+static unsigned char env_pressure = 0;      // channel pressure of the owning note, 0-127
+
+// fraction of the distance to the target per tick in 1/65536, for time
+// constants from 1 ms to 10 s in equal ratios at 1 kHz
+static const unsigned int env_coef[128] = {
+    41427, 39680, 37942, 36220, 34523, 32857, 31227, 29638,
+    28094, 26598, 25154, 23763, 22426, 21144, 19918, 18747,
+    17631, 16569, 15560, 14604, 13697, 12840, 12030, 11266,
+    10545,  9866,  9227,  8626,  8061,  7531,  7034,  6567,
+     6130,  5720,  5337,  4978,  4643,  4329,  4036,  3762,
+     3506,  3267,  3043,  2835,  2641,  2460,  2291,  2133,
+     1986,  1849,  1722,  1603,  1492,  1389,  1292,  1203,
+     1119,  1042,   969,   902,   839,   781,   727,   676,
+      629,   585,   544,   506,   471,   438,   408,   379,
+      353,   328,   305,   284,   264,   246,   229,   213,
+      198,   184,   171,   159,   148,   138,   128,   119,
+      111,   103,    96,    89,    83,    77,    72,    67,
+       62,    58,    54,    50,    46,    43,    40,    37,
+       35,    32,    30,    28,    26,    24,    22,    21,
+       19,    18,    17,    16,    15,    14,    13,    12,
+       11,    10,     9,     9,     8,     8,     7,     7 };
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Move a level toward its target by coef/65536 of the distance
+static long envStep(long level, long target, unsigned int coef)
+{
+    // the distance fits 16 bits after the shift, so this is one 16x16 multiply
+    if (target >= level)
+        return level + (long)(((unsigned long)(unsigned int)((target - level) >> 8) * coef) >> 8);
+    return level - (long)(((unsigned long)(unsigned int)((level - target) >> 8) * coef) >> 8);
+}
+
+
+// Start the envelope for a new note, legato is 1 if another note is still held
+void envNoteOn(unsigned char velocity, unsigned char legato)
+{
+    if (legato && preset->env_mode == ENV_MODE_LEGATO && env_stage != ENV_IDLE && env_stage != ENV_RELEASE) return;
+
+    // full scale at velocity 127, down to 1 - depth at velocity 0
+    env_gain  = 128 - ((unsigned int)preset->env_vel_depth * (127 - velocity)) / 127;
+    env_stage = ENV_ATTACK;                 // from the current level, no click on retrigger
+}
+
+
+// Release the envelope
+void envNoteOff(void)
+{
+    if (env_stage != ENV_IDLE) env_stage = ENV_RELEASE;
+}
+
+
+// Channel pressure of the note that owns the output
+void envPressure(unsigned char pressure)
+{
+    env_pressure = pressure & 0x7F;
+}
+
+
+// Stop the envelope at 0
+void envReset(void)
+{
+    env_stage = ENV_IDLE;
+    env_level = 0;
+    SET_DAC3(0);
+}
+
+
+// Advance the envelope by one control tick, called from the TB3 CCR0 interrupt
+void envTick(void)
+{
+    long sustain = (long)preset->env_sustain * ENV_SUSTAIN_STEP;
+    unsigned int gain = env_gain + (((128 - env_gain) * env_pressure) >> 7);
+    unsigned int out;
+
+    switch (env_stage)
+    {
+        case ENV_ATTACK:
+            env_level = envStep(env_level, ENV_FULL + ENV_OVERSHOOT, env_coef[preset->env_attack & 0x7F]);
+            if (env_level >= ENV_FULL)
+            {
+                env_level = ENV_FULL;
+                env_stage = ENV_DECAY;
+            }
+            break;
+
+        case ENV_DECAY:
+            env_level = envStep(env_level, sustain - ENV_UNDERSHOOT, env_coef[preset->env_decay & 0x7F]);
+            if (env_level <= sustain)
+            {
+                env_level = sustain;
+                env_stage = ENV_SUSTAIN;
+            }
+            break;
+
+        case ENV_SUSTAIN:
+            env_level = sustain;            // follows sustain edits
+            break;
+
+        case ENV_RELEASE:
+            env_level = envStep(env_level, -ENV_UNDERSHOOT, env_coef[preset->env_release & 0x7F]);
+            if (env_level <= 0)
+            {
+                env_level = 0;
+                env_stage = ENV_IDLE;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // 12-bit DAC, ENV_FULL >> 11 is 4096
+    out = (unsigned int)(((unsigned long)(unsigned int)(env_level >> 11) * gain) >> 7);
+    SET_DAC3((out > 0x0FFF) ? 0x0FFF : out);
+}
@@ -0,0 +1,52 @@
+/*
+ * env.h
+ *
+ * ADSR envelope generator on DAC3, run from the control tick
+ *
+ */
+
+#ifndef ENV_H_
+#define ENV_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+// envelope stages
+#define ENV_IDLE          0
+#define ENV_ATTACK        1
+#define ENV_DECAY         2
+#define ENV_SUSTAIN       3
+#define ENV_RELEASE       4
+
+#define ENV_FULL          0x00800000L                   // full scale level
+#define ENV_OVERSHOOT     (ENV_FULL / 4)                // attack aims above full scale like an RC charge
+#define ENV_UNDERSHOOT    (ENV_FULL / 64)               // decay and release aim below their end level
+#define ENV_SUSTAIN_STEP  (ENV_FULL / 127)              // level per step of the sustain parameter
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern volatile unsigned char env_stage;    // ENV_*, advanced by envTick
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void envNoteOn(unsigned char velocity, unsigned char legato);   // Start the envelope for a new note
+void envNoteOff(void);                                  // Release the envelope
+void envPressure(unsigned char pressure);               // Channel pressure of the note that owns the output
+void envReset(void);                                    // Stop the envelope at 0
+void envTick(void);                                     // Advance the envelope by one control tick
+
+
+#endif /* ENV_H_ */
@@ -0,0 +1,144 @@
+/*
+ * fine.c
+ *
+ * With PITCH_FINE_DAC a second, attenuated DAC (DAC3 on P3.5) is summed into
+ * the pitch CV on the VCO board. pitchOut puts the whole pitch DAC steps of a
+ * pitch on DAC0 and the 1/16 step remainder on DAC3, scaled by dac_fine, the
+ * fine DAC codes that make one pitch DAC step.
+ *
+ * The attenuator sets that ratio, so it is measured after every full tune
+ * with the frequency counter at A4: once as tuned, once FINE_CAL_STEPS pitch
+ * DAC steps higher and once with the fine DAC at FINE_CAL_CODE. Over a few
+ * percent of pitch the period is linear enough in both DACs, so
+ *
+ *   dac_fine = FINE_CAL_CODE * (t0 - t1) / (FINE_CAL_STEPS * (t0 - t2))
+ *
+ * A failed measurement, or a ratio above FINE_RATIO_MAX where the fine DAC
+ * cannot reach the next pitch DAC step, keeps the last ratio. Until one has been measured
+ * dac_fine is 0, the calibration record says so, and pitchOut rounds to whole
+ * pitch DAC steps with the fine DAC at 0. The counter needs the VCO running,
+ * so HARD SYNC is released for the three measurements and set again after.
+ *
+ */
+
+#include <mcu_vco.h>
+#include <fine.h>
+#include <midi_luts.h>
+#include <retune.h>
+#include <fram_store.h>
+#include <verify.h>
+
+#if PITCH_FINE_DAC == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+volatile unsigned char f_fine_cal = 0;
+
+static unsigned char step;              // measurement running, 0 to 2
+static unsigned int  t_step[3];         // tuned, coarse up, fine full scale
+static unsigned int  meas_start;        // ctrl_ticks when the running measurement started
+
+// state owned by main.c
+extern volatile unsigned int ctrl_ticks;
+extern unsigned int t_meas;
+extern unsigned char num_ignored;
+extern unsigned int dac_expoff;
+extern unsigned int dac_exp;
+extern unsigned int dac_fine;
+#if DEBUG == 1
+    extern char debug_msg[SIZE_MESSAGE];
+#endif
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Set both DACs and measure, after NUM_IGNORED periods to settle
+static void fineMeasure(unsigned int coarse, unsigned int fine)
+{
+    setPitchDAC(coarse, fine);
+    meas_periods = FINE_GATE_CNT / retuneTargetCount(FINE_CAL_NOTE);
+    meas_start   = ctrl_ticks;
+    num_ignored  = 0;
+    f_fine_cal = 2;
+    initFreqCtr();
+}
+
+
+// Work out the ratio and keep it, then mute and hand over to the sweep
+static void fineDone(unsigned char ok)
+{
+    unsigned long ratio = 0;
+
+    if (ok && t_step[0] > t_step[1] && t_step[0] > t_step[2])
+    {
+        ratio = ((unsigned long)FINE_CAL_CODE * (t_step[0] - t_step[1]))
+              / ((unsigned long)FINE_CAL_STEPS * (t_step[0] - t_step[2]));
+    }
+
+    // a full fine sweep short of a step would clamp and glitch at every step
+    if (ratio > 0 && ratio <= FINE_RATIO_MAX)
+    {
+        dac_fine = (unsigned int)ratio;
+        calSave(dac_expoff, dac_exp, dac_fine);
+        #if DEBUG == 1
+            sprintf(debug_msg, "   FINE DAC = %d / STEP\r\n", dac_fine);
+            UCA1IE |= UCTXIE;
+        #endif
+    }
+    else
+    {
+        #if DEBUG == 1
+            sprintf(debug_msg, "   FINE DAC FAILED\r\n");
+            UCA1IE |= UCTXIE;
+        #endif
+    }
+
+    SET_DAC0(0);
+    HARD_SYNC_ON;
+    f_fine_cal = 0;
+    #if PITCH_VERIFY == 1
+        f_verify = 1;
+    #endif
+}
+
+
+// Run one step of the calibration from the main loop
+void fineCalService(void)
+{
+    unsigned int coarse = conv_midi_to_dac(FINE_CAL_NOTE);
+
+    switch (f_fine_cal)
+    {
+        case 1:  // as tuned
+            step = 0;
+            HARD_SYNC_OFF;              // the counter needs edges
+            fineMeasure(coarse, 0);
+            break;
+
+        case 2:  // wait to start measuring
+        case 4:  // wait until measurement complete
+            if (ctrl_ticks - meas_start < FINE_TIMEOUT) break;
+            retuneAbort();
+            fineDone(0);
+            break;
+
+        case 8:  // next measurement or the result
+            t_step[step++] = t_meas;
+            if (step == 1)      fineMeasure(coarse + FINE_CAL_STEPS, 0);
+            else if (step == 2) fineMeasure(coarse, FINE_CAL_CODE);
+            else                fineDone(1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+#endif
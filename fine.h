@@ -0,0 +1,50 @@
+/*
+ * fine.h
+ *
+ * Fine pitch DAC on DAC3, calibration of its ratio to the pitch DAC step, PITCH_FINE_DAC build only
+ *
+ */
+
+#ifndef FINE_H_
+#define FINE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define FINE_CAL_NOTE       69                      // A4, where the ratio is measured
+#define FINE_CAL_STEPS      8                       // pitch DAC steps measured against the fine full scale
+#define FINE_CAL_CODE       4095                    // fine DAC code measured against 0
+#define FINE_RATIO_MAX      (4095UL * 16 / 15)      // largest dac_fine that puts 15/16 step within the fine DAC, 4368
+#define FINE_GATE_CNT       (TUNE_CLK_FREQ / 6)     // tune clock counts per measurement, below 65536 at 24 MHz
+#define FINE_TIMEOUT        1000                    // control ticks without a result before the calibration fails
+
+// 1 while the calibration runs
+#if PITCH_FINE_DAC == 1
+    #define fineCalBusy()   (f_fine_cal != 0)
+#else
+    #define fineCalBusy()   0
+#endif
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern volatile unsigned char f_fine_cal;       // calibration flag, 1 starts it, advanced by Timer1_B1_ISR
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void fineCalService(void);                              // Run one step of the calibration from the main loop
+
+
+#endif /* FINE_H_ */
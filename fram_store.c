@@ -0,0 +1,147 @@
+/*
+ * fram_store.c
+ *
+ * A block restored over SysEx is decoded into fram_stage while it arrives.
+ * Once its CRC checks out, fram_commit records which block the stage holds
+ * and is marked pending with a single write. The copy into place runs from
+ * the main loop and only clears pending when it is done, so a reset in the
+ * middle is finished by framStoreInit on the next boot and a block is never
+ * left half old and half new.
+ *
+ */
+
+#include <fram_store.h>
+#include <mcu_vco.h>
+#include <preset.h>
+#include <mts.h>
+#include <trace.h>
+#include <string.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+FRAM_PERSISTENT(fram_cal)
+struct cal_data fram_cal = { 0, INIT_EXP_OFFSET, DAC_OUT_1V25, 0 };   // invalid until the first tune
+
+FRAM_PERSISTENT(fram_cfg)
+struct cfg_data fram_cfg = { 0, 0 };
+
+FRAM_PERSISTENT(fram_stage)
+unsigned char fram_stage[SIZE_FRAM_STAGE] = { 0 };
+
+FRAM_PERSISTENT(fram_commit)
+struct fram_commit fram_commit = { 0, 0, 0 };
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// CRC-16-CCITT (polynomial 0x1021) one nibble at a time, start with 0xFFFF
+unsigned int crc16(unsigned int crc, unsigned char byte)
+{
+    static const unsigned int crc_nibble[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+
+    crc = (crc << 4) ^ crc_nibble[((crc >> 12) ^ (byte >> 4)) & 0x0F];
+    crc = (crc << 4) ^ crc_nibble[((crc >> 12) ^ byte) & 0x0F];
+    return crc & 0xFFFF;
+}
+
+
+// CRC of the calibration record, without the crc field
+static unsigned int calCrc(void)
+{
+    const unsigned char *p = (const unsigned char *)&fram_cal;
+    unsigned int crc = 0xFFFF;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(fram_cal) - sizeof(fram_cal.crc); i++) crc = crc16(crc, p[i]);
+    return crc;
+}
+
+
+// Check the calibration record, 1 if it can be used without tuning
+unsigned char calValid(void)
+{
+    return fram_cal.version == CAL_VERSION && fram_cal.crc == calCrc();
+}
+
+
+// Write a checksummed calibration record
+void calSave(unsigned int dac_expoff, unsigned int dac_exp, unsigned int dac_fine)
+{
+    fram_cal.crc        = 0;    // invalid while the fields change
+    fram_cal.version    = CAL_VERSION;
+    fram_cal.dac_expoff = dac_expoff;
+    fram_cal.dac_exp    = dac_exp;
+    fram_cal.dac_fine   = dac_fine;
+    fram_cal.crc        = calCrc();
+}
+
+
+// FRAM address of a block
+unsigned char *framBlockAddr(unsigned char block)
+{
+    switch (block)
+    {
+        case FRAM_BLOCK_CAL: return (unsigned char *)&fram_cal;
+        case FRAM_BLOCK_CFG: return (unsigned char *)&fram_cfg;
+        case FRAM_BLOCK_PRESET: return (unsigned char *)preset_bank;
+    #if FLIGHT_TRACE == 1
+        case FRAM_BLOCK_TRACE: return (unsigned char *)&trace_log;
+    #endif
+        case FRAM_BLOCK_TUNING: return (unsigned char *)&fram_mts;
+        default:             return 0;
+    }
+}
+
+
+// Size of a block in bytes, 0 if the block does not exist
+unsigned int framBlockSize(unsigned char block)
+{
+    switch (block)
+    {
+        case FRAM_BLOCK_CAL: return sizeof(fram_cal);
+        case FRAM_BLOCK_CFG: return sizeof(fram_cfg);
+        case FRAM_BLOCK_PRESET: return sizeof(preset_bank);
+    #if FLIGHT_TRACE == 1
+        case FRAM_BLOCK_TRACE: return sizeof(trace_log);
+    #endif
+        case FRAM_BLOCK_TUNING: return sizeof(fram_mts);
+        default:             return 0;
+    }
+}
+
+
+// Mark the stage as holding a complete block
+void framStage(unsigned char block, unsigned int len)
+{
+    fram_commit.block   = block;
+    fram_commit.len     = len;
+    fram_commit.pending = 1;
+}
+
+
+// Copy a staged block into place, returns the block or 0xFF if none was pending
+unsigned char framCommit(void)
+{
+    unsigned char block = fram_commit.block;
+
+    if (!fram_commit.pending) return 0xFF;
+
+    memcpy(framBlockAddr(block), fram_stage, fram_commit.len);
+    fram_commit.pending = 0;
+    return block;
+}
+
+
+// Finish a commit interrupted by reset
+void framStoreInit(void)
+{
+    framCommit();
+}
@@ -0,0 +1,97 @@
+/*
+ * fram_store.h
+ *
+ * Settings kept in FRAM and the staging area used to restore them
+ *
+ */
+
+#ifndef FRAM_STORE_H_
+#define FRAM_STORE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+// blocks that can be dumped and restored over SysEx
+#define FRAM_BLOCK_CAL    0     // tune results
+#define FRAM_BLOCK_CFG    1     // unit configuration
+#define FRAM_BLOCK_PRESET 2     // preset bank
+#define FRAM_BLOCK_TRACE  3     // flight recorder, dump only
+#define FRAM_BLOCK_TUNING 4     // MTS tuning table
+#define NUM_FRAM_BLOCKS   5
+
+#define SIZE_FRAM_STAGE   512   // must hold the largest restorable block, the preset bank
+
+#define CAL_VERSION       2     // struct cal_data layout, older records force a full tune
+
+// Place a variable in FRAM so it keeps its value over reset and power loss.
+// .TI.persistent sits below the FRWP offset, so it stays writable at run time.
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+    #define FRAM_PRAGMA(x)          _Pragma(#x)
+    #define FRAM_PERSISTENT(var)    FRAM_PRAGMA(PERSISTENT(var))
+#elif defined(__GNUC__)
+    #define FRAM_PERSISTENT(var)    __attribute__((persistent))
+#else
+    #error Compiler not supported!
+#endif
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// tune results
+struct cal_data {
+    unsigned int version;       // CAL_VERSION
+    unsigned int dac_expoff;    // EXP FREQ offset DAC value
+    unsigned int dac_exp;       // EXP SCALE DAC value
+    unsigned int dac_fine;      // fine DAC codes per pitch DAC step, PITCH_FINE_DAC, 0 if never measured
+    unsigned int crc;           // crc16 of the fields above, written last
+};
+
+// unit configuration
+struct cfg_data {
+    unsigned char midi_channel;
+    unsigned char program;      // active preset
+};
+
+// staged block waiting to be copied into place
+struct fram_commit {
+    unsigned int  len;
+    unsigned char block;
+    unsigned char pending;      // written last, the stage is only used while set
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern struct cal_data fram_cal;
+extern struct cfg_data fram_cfg;
+extern unsigned char fram_stage[SIZE_FRAM_STAGE];
+extern struct fram_commit fram_commit;
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+unsigned int crc16(unsigned int crc, unsigned char byte);   // CRC-16-CCITT, start with 0xFFFF
+unsigned char calValid(void);                               // Check the calibration record
+void calSave(unsigned int dac_expoff, unsigned int dac_exp, unsigned int dac_fine);   // Write a checksummed calibration record
+unsigned char *framBlockAddr(unsigned char block);          // FRAM address of a block
+unsigned int framBlockSize(unsigned char block);            // Size of a block in bytes
+void framStage(unsigned char block, unsigned int len);      // Mark the stage as holding a complete block
+unsigned char framCommit(void);                             // Copy a staged block into place
+void framStoreInit(void);                                   // Finish a commit interrupted by reset
+
+
+#endif /* FRAM_STORE_H_ */
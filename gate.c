@@ -0,0 +1,112 @@
+/*
+ * gate.c
+ *
+ * The gate is high while any note is held, and every new note also sends a
+ * trigger pulse, so an envelope downstream retriggers on legato notes where
+ * the gate stays high.
+ *
+ * Software only picks the time of an edge. Each edge is a TB3 compare output
+ * set GATE_DELAY_CNT after the pitch DAC write, so it lands the same time
+ * after the new pitch wherever the main loop was. OUTMOD_1 sets the output at
+ * the compare and OUTMOD_5 resets it, and switching between the two keeps
+ * OUTMOD bit 0 set, so a change of mode never glitches the pin. The trigger
+ * takes one CCR2 interrupt per edge to schedule the next one; the edge itself
+ * does not wait on that interrupt.
+ *
+ * The deadline is only GATE_DELAY_CNT ahead, so it is taken and written with
+ * interrupts off. Should TB3R still be past it once written, the compare may
+ * have been missed and would only match a whole rollover later, so the edge
+ * is forced with OUTMOD_0 instead.
+ *
+ */
+
+#include <gate.h>
+#include <mcu_vco.h>
+
+#if GATE_OUT == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+static volatile unsigned char trig_high = 0;    // the trigger rose, its fall is scheduled
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// The pitch DAC was just written, gate up and a trigger for a new note
+void gateOut(unsigned char retrig)
+{
+    unsigned short state;
+    unsigned int t;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    t = TB3R + GATE_DELAY_CNT;
+    TB3CCR1  = t;
+    TB3CCTL1 = OUTMOD_1;                // set, stays high if a note already held it
+
+    // a trigger still high is stretched to a full width from the new edge
+    if (retrig)
+    {
+        trig_high = 0;
+        TB3CCR2  = t;
+        TB3CCTL2 = OUTMOD_1 | CCIE;     // also clears a pending CCIFG
+    }
+
+    // deadline missed, raise both now and time the trigger fall from here
+    if ((int)(t - TB3R) <= 0)
+    {
+        TB3CCTL1 = OUTMOD_0 | OUT;
+        if (retrig)
+        {
+            TB3CCTL2 = OUTMOD_0 | OUT;
+            trig_high = 1;
+            TB3CCR2  = TB3R + GATE_TRIG_CNT;
+            TB3CCTL2 = OUTMOD_5 | CCIE;
+        }
+    }
+    __set_interrupt_state(state);
+}
+
+
+// No note held, gate down
+void gateOff(void)
+{
+    unsigned short state;
+    unsigned int t;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    t = TB3R + GATE_DELAY_CNT;
+    TB3CCR1  = t;
+    TB3CCTL1 = OUTMOD_5;                // reset
+    if ((int)(t - TB3R) <= 0) TB3CCTL1 = OUTMOD_0;   // deadline missed, down now
+    __set_interrupt_state(state);
+}
+
+
+// TB3 CCR2 compare, the trigger edge just happened
+void gateTrigEdge(void)
+{
+    if (!trig_high)
+    {
+        // rose, fall after the pulse width
+        trig_high = 1;
+        TB3CCR2 += GATE_TRIG_CNT;
+        TB3CCTL2 = OUTMOD_5 | CCIE;
+    }
+    else
+    {
+        // fell, nothing more until the next note
+        trig_high = 0;
+        TB3CCTL2 = OUTMOD_5;
+    }
+}
+
+
+#endif
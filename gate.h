@@ -0,0 +1,37 @@
+/*
+ * gate.h
+ *
+ * Gate on P6.0 (TB3.1) and trigger on P6.1 (TB3.2), edges from TB3 compare outputs
+ *
+ */
+
+#ifndef GATE_H_
+#define GATE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define GATE_DELAY_CNT    ((unsigned int)(SMCLK_FREQ / 100000))                 // edges 10 us after the pitch DAC write
+#define GATE_TRIG_CNT     ((unsigned int)(SMCLK_FREQ / 1000000 * TRIG_WIDTH_US)) // trigger pulse in TB3 counts
+
+#if TRIG_WIDTH_US < 10 || TRIG_WIDTH_US > 2000
+  #error TRIG_WIDTH_US must be 10 to 2000, one TB3 rollover at 24 MHz is 2.7 ms
+#endif
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void gateOut(unsigned char retrig);                     // The pitch DAC was just written, gate up and a trigger for a new note
+void gateOff(void);                                     // No note held, gate down
+void gateTrigEdge(void);                                // TB3 CCR2 compare, the trigger edge just happened
+
+
+#endif /* GATE_H_ */
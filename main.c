@@ -4,9 +4,13 @@
  * The VCO supports the following MIDI messages:
  *   NOTE OFF
  *   NOTE ON
- *   PITCH BEND
+ *   PITCH BEND (14-bit)
+ *   CONTROL - 14-BIT CONTROLLER PAIRS
+ *   CONTROL - RPN 0/1/2 (BEND RANGE, FINE TUNE, COARSE TUNE) AND NRPN
+ *   CONTROL - RESET ALL CONTROLLERS
  *   CONTROL - ALL SOUND OFF
  *   CONTROL - ALL NOTES OFF
+ *   PROGRAM CHANGE
  *   TUNE REQUEST
  *   ACTIVE SENSING
  *
@@ -21,6 +25,27 @@
 #include <mcu_vco.h>
 #include <midi.h>
 #include <midi_luts.h>
+#include <midi_io.h>
+#include <midi_cc.h>
+#include <pitch.h>
+#include <retune.h>
+#include <fram_store.h>
+#include <sysex.h>
+#include <preset.h>
+#include <stress.h>
+#include <env.h>
+#include <trace.h>
+#include <timer_wheel.h>
+#include <tune.h>
+#include <mts.h>
+#include <mpe.h>
+#include <verify.h>
+#include <prof.h>
+#include <gate.h>
+#include <sched.h>
+#include <fine.h>
+#include <cv.h>
+#include <track.h>
 #include <float.h>
 
 
@@ -34,18 +59,38 @@ unsigned char midi_channel  = 0;
 // midi event flags
 unsigned char f_midi_note_on    = 0;
 unsigned char f_midi_note_off   = 0;
-unsigned char f_midi_pitch_bend = 0;
 
 // midi note stack
 struct note midi_notes[SIZE_NOTE_STACK];
 unsigned char ptr_note = 0;
 
-// midi pitch bend value
+// control ticks (ms) since reset, trace time base
+volatile unsigned int ctrl_ticks = 0;
+unsigned int pitch_tick = 0;        // tick of the last bend update, one per tick
+
+// active sensing, armed once ACTIVE SENSING is seen
+struct sw_timer sensing_timer;
+unsigned char f_sensing = 0;
+
+// envelope released, output muted when it finishes
+unsigned char f_env_release = 0;
+
+// CV input, the output was taken by MIDI (or never sounded) and needs cv_note again
+#if CV_IN == 1
+    unsigned char f_cv_resound = 1;
+#endif
+
+// midi pitch bend value, -8192 to 8191
 int midi_pitch_bend_val = 0;
 
 // midi rx values
 unsigned char midi_note_val = 0;
 unsigned char midi_note_vel = 0;
+unsigned char midi_note_ch  = 0;
+#if NOTE_SCHED == 1
+    unsigned int midi_note_time = 0;    // TB3R when the note message arrived
+#endif
+unsigned char note_retrig = 0;          // the next pitch output is a new note, send a trigger
 
 // Debug UART terminal transmit variables
 #if DEBUG == 1
@@ -58,12 +103,29 @@ unsigned char midi_note_vel = 0;
 // tuning flags
 unsigned char f_exp_offset_tune = 0;
 unsigned char f_exp_scale_tune = 0;
+volatile unsigned char f_tune_request = 0;  // MIDI TUNE REQUEST or 't' on the debug terminal
 
 // tuning variables
 unsigned int dac_expoff = INIT_EXP_OFFSET;  // dac value for EXP FREQ offset
 unsigned int dac_exp = DAC_OUT_1V25;        // dac value for EXP SCALE adjust
+unsigned int dac_fine = 0;                  // fine DAC codes per pitch DAC step, 0 until measured
 unsigned int t_meas  = 0;                   // time measurement in tuning process
 unsigned char num_ignored = 0;              // number of pulses to ignore at the beginning of tuning
+unsigned int tune_meas_start = 0;           // ctrl_ticks when the running tune measurement started
+
+// parse buffered MIDI bytes, called from the MIDI RX interrupts
+void midiParse(void);
+
+// note priority of the active preset
+unsigned char notePriority(unsigned char top);
+unsigned char soundingNote(void);
+
+// ACTIVE SENSING timed out
+void sensingTimeout(void);
+
+// start-up tune measurements
+void tuneMeasure(void);
+void tuneFail(void);
 
 //******************************************************************************
 // MAIN ************************************************************************
@@ -74,30 +136,130 @@ int main(void)
     // stop watchdog time
 	WDTCTL = WDTPW | WDTHOLD;
 
+	// why we are here, for the flight recorder
+	#if FLIGHT_TRACE == 1
+	    unsigned int reset_cause = SYSRSTIV;
+	#endif
+
 	// call device initialization functions
 	initGPIO();
-	initClockTo16MHz();
+	initClock();
 	initUARTs();
 	initDACs();
+	#if CV_IN == 1
+	    initADC();                      // after the reference
+	#endif
 	initMIDINotes(midi_notes);
+	initCtrlTimer();
+
+	// settings kept in FRAM
+	framStoreInit();
+	mtsBuild();                         // pitch table from the MTS tuning
+	presetSelect(fram_cfg.program);     // also sets midi_channel
+	#if FLIGHT_TRACE == 1
+	    traceBoot(reset_cause);
+	#endif
 
 	// Enable interrupts
 	  __bis_SR_register(GIE);
 
-	// print header to debug terminal
-    #if DEBUG == 1
-	    sprintf(header_msg,HEADER);
-	    UCA1IE |= UCTXIE;
-    #else
-	    f_exp_offset_tune = 1;
-    #endif
-
-	HARD_SYNC_OFF;          // start with HARD SYNC off
 	SET_DAC0(0);            // no notes played
-	SET_DAC1(dac_exp);      // initial EXP SCALE tune value
+
+	if (calValid())
+	{
+	    // warm boot: restore the last tune and play right away
+	    dac_expoff = fram_cal.dac_expoff;
+	    dac_exp    = fram_cal.dac_exp;
+	    dac_fine   = fram_cal.dac_fine;
+	    SET_DAC2(dac_expoff);
+	    SET_DAC1(dac_exp);
+	    TRACE_EVT(TRACE_DAC, 2, dac_expoff);
+	    TRACE_EVT(TRACE_DAC, 1, dac_exp);
+	    HARD_SYNC_ON;       // muted until the first note
+        #if DEBUG == 1
+	        f_print_start = 0;
+	        sprintf(debug_msg, "Warm boot %d %d\r\n", dac_expoff, dac_exp);
+	        UCA1IE |= UCTXIE;
+        #endif
+	}
+	else
+	{
+	    // cold boot: print header to debug terminal, then tune
+        #if DEBUG == 1
+	        sprintf(header_msg,HEADER);
+	        UCA1IE |= UCTXIE;
+        #else
+	        f_exp_offset_tune = 1;
+        #endif
+
+	    HARD_SYNC_OFF;          // start with HARD SYNC off
+	    SET_DAC1(dac_exp);      // initial EXP SCALE tune value
+	}
 
 	while(1)
 	{
+	    // full tune on request, starting from the current calibration
+	    if (f_tune_request)
+	    {
+	        f_tune_request = 0;
+	        if (!f_exp_offset_tune && !f_exp_scale_tune)
+	        {
+	            retuneAbort();
+	            initMIDINotes(midi_notes);
+	            ptr_note = 0;
+	            f_midi_note_on = f_midi_note_off = coal_pitch.dirty = 0;
+                #if ENV_OUT == 1
+	                envReset();
+	                f_env_release = 0;
+                #endif
+	            SET_DAC0(0);
+	            HARD_SYNC_OFF;          // the counter needs the VCO running, muted again when the tune ends
+                #if NOTE_SCHED == 1
+	                schedCancel();
+                #endif
+                #if GATE_OUT == 1
+	                gateOff();
+                #endif
+                #if PITCH_VERIFY == 1
+	                f_verify = 0;
+                #endif
+                #if PITCH_FINE_DAC == 1
+	                f_fine_cal = 0;
+                #endif
+	            f_exp_offset_tune = 1;
+	        }
+	    }
+
+        #if PITCH_VERIFY == 1
+	    // pitch verification sweep on request, held notes dropped like a tune
+	    if (f_verify_request)
+	    {
+	        f_verify_request = 0;
+	        if (!f_exp_offset_tune && !f_exp_scale_tune && !f_verify && !fineCalBusy())
+	        {
+	            retuneAbort();
+                #if PITCH_TRACK == 1
+	                trackStop();
+                #endif
+	            initMIDINotes(midi_notes);
+	            ptr_note = 0;
+	            f_midi_note_on = f_midi_note_off = coal_pitch.dirty = 0;
+                #if ENV_OUT == 1
+	                envReset();
+	                f_env_release = 0;
+                #endif
+	            HARD_SYNC_ON;
+                #if NOTE_SCHED == 1
+	                schedCancel();
+                #endif
+                #if GATE_OUT == 1
+	                gateOff();
+                #endif
+	            f_verify = 1;
+	        }
+	    }
+        #endif
+
 	    // tune mode
 	    if (f_exp_offset_tune)
 	    {
@@ -105,21 +267,25 @@ int main(void)
 	        switch(f_exp_offset_tune)
 	        {
 	            case 1:  // set tune EXP FREQ offset
+                    #if PITCH_TRACK == 1
+                        trackStop();        // the tune needs the frequency counter
+                    #endif
                     #if DEBUG == 1
                        sprintf(debug_msg, "Beginning tune process...\r\n");
                        UCA1IE |= UCTXIE;
                     #endif
 	                SET_DAC2(dac_expoff);
                     f_exp_offset_tune = 2;
-                    initFreqCtr();
+                    tuneMeasure();
 	                break;
 	            case 2:  // wait to start measuring
-	                break;
 	            case 4:  // wait until measurement complete
+	                if (ctrl_ticks - tune_meas_start >= TUNE_TIMEOUT) tuneFail();
 	                break;
 	            case 8:  // check measurement
-	                if (t_meas < CNT_AT_0V + CNT_AT_0V_TOL && t_meas > CNT_AT_0V - CNT_AT_0V_TOL)
+	                if (tuneOffsetStep(t_meas) == 0)
 	                {
+	                    TRACE_EVT(TRACE_TUNE, TRACE_TUNE_OFFSET, dac_expoff);
 	                    f_exp_offset_tune = 0;
 	                    f_exp_scale_tune = 1;
 	                    #if DEBUG == 1
@@ -127,15 +293,15 @@ int main(void)
 	                        UCA1IE |= UCTXIE;
 	                    #endif
 	                }
-	                else if (t_meas > CNT_AT_0V)
+	                else if (tuneOffsetStep(t_meas) > 0)
 	                {
 	                    #if DEBUG == 1
 	                        sprintf(debug_msg, "   t = %d, EXP FREQ up\r\n", t_meas);
 	                        UCA1IE |= UCTXIE;
 	                    #endif
-	                    SET_DAC2(dac_expoff++);
+	                    SET_DAC2(++dac_expoff);
 	                    f_exp_offset_tune = 2;
-	                    initFreqCtr();
+	                    tuneMeasure();
 	                }
 	                else
 	                {
@@ -143,9 +309,9 @@ int main(void)
 	                        sprintf(debug_msg, "   t = %d, EXP FREQ down\r\n", t_meas);
 	                        UCA1IE |= UCTXIE;
 	                    #endif
-	                    SET_DAC2(dac_expoff--);
+	                    SET_DAC2(--dac_expoff);
                         f_exp_offset_tune = 2;
-                        initFreqCtr();
+                        tuneMeasure();
 	                }
 	                break;
 	            default:
@@ -160,31 +326,41 @@ int main(void)
                 case 1:  // set tune EXP SCALE
                     SET_DAC0(conv_midi_to_dac(69));
                     f_exp_scale_tune = 2;
-                    initFreqCtr();
+                    tuneMeasure();
                     break;
                 case 2:  // wait to start measuring
-                    break;
                 case 4:  // wait until measurement complete
+                    if (ctrl_ticks - tune_meas_start >= TUNE_TIMEOUT) tuneFail();
                     break;
                 case 8:  // check measurement
-                    if (t_meas < CNT_AT_440 + TUNE_FREQ_TOL && t_meas > CNT_AT_440 - TUNE_FREQ_TOL)
+                    if (tuneScaleStep(t_meas) == 0)
                     {
                         f_exp_scale_tune = 0;
+                        TRACE_EVT(TRACE_TUNE, TRACE_TUNE_SCALE, dac_exp);
                         #if DEBUG == 1
                             sprintf(debug_msg, "   EXP SCALE OFFSET = %d\r\n", dac_exp);
                             UCA1IE |= UCTXIE;
                         #endif
                         HARD_SYNC_ON;
+
+                        // keep the result in FRAM for the next warm boot, dac_fine as last measured or 0
+                        calSave(dac_expoff, dac_exp, dac_fine);
+
+                        #if PITCH_FINE_DAC == 1
+                            f_fine_cal = 1;     // then the fine DAC ratio, the sweep follows it
+                        #elif PITCH_VERIFY == 1
+                            f_verify = 1;       // check every note against the new calibration
+                        #endif
                     }
-                    else if (t_meas < CNT_AT_440)
+                    else if (tuneScaleStep(t_meas) > 0)
                     {
                         #if DEBUG == 1
                             sprintf(debug_msg, "   t = %d, EXP SCALE up\r\n", t_meas);
                             UCA1IE |= UCTXIE;
                         #endif
-                        SET_DAC1(dac_exp++);
+                        SET_DAC1(++dac_exp);
                         f_exp_scale_tune = 2;
-                        initFreqCtr();
+                        tuneMeasure();
                     }
                     else
                     {
@@ -192,9 +368,9 @@ int main(void)
                             sprintf(debug_msg, "   t = %d, EXP SCALE down\r\n", t_meas);
                             UCA1IE |= UCTXIE;
                         #endif
-                        SET_DAC1(dac_exp--);
+                        SET_DAC1(--dac_exp);
                         f_exp_scale_tune = 2;
-                        initFreqCtr();
+                        tuneMeasure();
                     }
                     break;
                 default:
@@ -202,12 +378,43 @@ int main(void)
 	        }
 	    }
 
+        #if PITCH_FINE_DAC == 1
+	    // fine DAC calibration
+	    else if (f_fine_cal)
+	    {
+	        fineCalService();
+	    }
+        #endif
+        #if PITCH_VERIFY == 1
+	    // pitch verification sweep
+	    else if (f_verify)
+	    {
+	        verifyService();
+	    }
+        #endif
 	    // play mode
 	    else
         {
-            if (f_midi_pitch_bend == 4)
+            // ALL NOTES OFF or ALL SOUND OFF
+            if (f_all_notes_off)
             {
-                f_midi_pitch_bend = 8;
+                f_all_notes_off = 0;
+                TRACE_EVT(TRACE_ALL_OFF, 0, 0);
+                initMIDINotes(midi_notes);
+                ptr_note = 0;
+                f_midi_note_on = f_midi_note_off = 0;
+                #if ENV_OUT == 1
+                    envReset();
+                    f_env_release = 0;
+                #endif
+                SET_DAC0(0);
+                HARD_SYNC_ON;
+                #if NOTE_SCHED == 1
+                    schedCancel();
+                #endif
+                #if GATE_OUT == 1
+                    gateOff();
+                #endif
             }
 
             if (f_midi_note_on == 4)
@@ -215,24 +422,55 @@ int main(void)
                 midi_notes[ptr_note].on       = 1;
                 midi_notes[ptr_note].value    = midi_note_val;
                 midi_notes[ptr_note].velocity = midi_note_vel;
+                midi_notes[ptr_note].channel  = midi_note_ch;
+                TRACE_EVT(TRACE_NOTE_ON, midi_note_val, ptr_note);
+
+                // gate the envelope, legato if another note is still held, with NOTE_SCHED along with the pitch
+                #if ENV_OUT == 1
+                    #if NOTE_SCHED == 0
+                        envNoteOn(midi_note_vel, ptr_note > 0);
+                    #endif
+                    f_env_release = 0;
+                #endif
+
+                // retrigger once the new pitch is out
+                note_retrig = 1;
 
                 f_midi_note_on = 8;
              }
 
              if (f_midi_note_on == 8)
              {
-                 unsigned int dac_val = conv_midi_to_dac(midi_notes[ptr_note].value);
+                 unsigned char n;
+                 unsigned int pitch;
+
+                 PROF_START(prof_note);
+                 n = notePriority(ptr_note);
+
+                 // its channel's MPE bend and pressure follow the note
+                 mpeOwner(midi_notes[n].channel);
+                 pitch = pitchQ4(midi_notes[n].value, midi_pitch_bend_val);
+
+                 // Set CV DAC value, with NOTE_SCHED a fixed delay after the note message
+                 #if NOTE_SCHED == 1
+                     if (note_retrig) schedNoteOn(pitch, midi_note_vel, ptr_note > 0, midi_note_time);
+                     else             schedNote(pitch, 0, midi_note_time);
+                 #else
+                     pitchOut(pitch);
+                     HARD_SYNC_OFF;
+                     #if GATE_OUT == 1
+                         gateOut(note_retrig);
+                     #endif
+                 #endif
+                 note_retrig = 0;
+                 PROF_END(prof_note);
 
-                 // report note on for debug
+                 // report note on for debug, once the DAC is set
                  #if DEBUG == 1
-                    sprintf(debug_msg, "N = %d  V = %d ON DAC = %d\r\n", midi_notes[ptr_note].value, midi_notes[ptr_note].velocity, dac_val);
+                    sprintf(debug_msg, "N = %d  V = %d ON DAC = %d\r\n", midi_notes[n].value, midi_notes[n].velocity, pitch >> 4);
                     UCA1IE |= UCTXIE;
                  #endif
 
-                 // Set CV DAC value
-                 SET_DAC0(dac_val & 0x0FFF);
-                 HARD_SYNC_OFF;
-
                  f_midi_note_on = 0;
                  ptr_note ++;
              }
@@ -252,7 +490,7 @@ int main(void)
                  for (i=0; i < SIZE_NOTE_STACK-1; ++i)
                  {
                      // find note in the stack and turn it off
-                     if (midi_notes[i].value == midi_note_val)
+                     if (midi_notes[i].value == midi_note_val && midi_notes[i].channel == midi_note_ch)
                      {
                          midi_notes[i].on = 0;
                      }
@@ -262,7 +500,7 @@ int main(void)
                          if (i>0) ptr_note = i-1;
                          else ptr_note = 0;
                          if (midi_notes[0].on) f_midi_note_on = 8;
-                         if (midi_pitch_bend_val != 0) f_midi_pitch_bend = 4;
+                         if (midi_pitch_bend_val != 0) coalPut(&coal_pitch);
                          break;
                      }
                      // shift up if current note off and next on
@@ -273,47 +511,349 @@ int main(void)
                      }
                  }
 
+                 TRACE_EVT(TRACE_NOTE_OFF, midi_note_val, ptr_note);
+
                  // turn output off if no note is currently played
                  if (midi_notes[0].on == 0)
                  {
+                     #if NOTE_SCHED == 1
+                         schedOff(midi_note_time);  // gate and release, or the mute without ENV_OUT, at the fixed delay
+                     #elif GATE_OUT == 1
+                         gateOff();             // the gate falls now, the envelope releases
+                     #endif
+                     #if ENV_OUT == 1
+                         // keep the pitch through the release
+                         #if NOTE_SCHED == 0
+                             envNoteOff();
+                         #endif
+                         f_env_release = 1;
+                     #elif NOTE_SCHED == 0
+                         SET_DAC0(0);
+                         HARD_SYNC_ON;
+                     #endif
+                 }
+             }
+
+             // mute once the release has finished, and any scheduled note has sounded
+             #if ENV_OUT == 1
+                 #if NOTE_SCHED == 1
+                 if (f_env_release && env_stage == ENV_IDLE && !schedPending())
+                 #else
+                 if (f_env_release && env_stage == ENV_IDLE)
+                 #endif
+                 {
+                     f_env_release = 0;
                      SET_DAC0(0);
                      HARD_SYNC_ON;
                  }
-             }
+             #endif
 
-             // adjust DAC output if pitch bend received
-             if (f_midi_pitch_bend == 8)
+             // adjust DAC output to the newest bend, tune or MPE bend, at most once per control tick
+             if (ctrl_ticks != pitch_tick && coalTake(&coal_pitch))
              {
-                 // report pitch bend message for debug
+                 pitch_tick = ctrl_ticks;
+
+                 // report pitch bend and the updates merged so far for debug
                  #if DEBUG == 1
-                     sprintf(debug_msg, "PB = %d \r\n", midi_pitch_bend_val);
+                     sprintf(debug_msg, "PB = %d M = %d\r\n", midi_pitch_bend_val, coal_pitch.merged);
                      UCA1IE |= UCTXIE;
                  #endif
 
-                 // clear pitch bend flag
-                 f_midi_pitch_bend = 0;
-
                  // if a note is on, bend it
-                 if (midi_notes[ptr_note-1].on)
+                 if (ptr_note > 0 && midi_notes[ptr_note-1].on)
                  {
-                     // calculate DAC output: note + bend
-                     unsigned int dac_val = (unsigned int)(   conv_midi_to_dac(midi_notes[ptr_note-1].value)
-                                                            + DAC_ADJ_SCALE * midi_pitch_bend_val            );
-                     // 0 Hz Out
-                     SET_DAC0(dac_val & 0x0FFF);
+                     // DAC output: note + tune + bend, queued behind any scheduled note
+                     #if NOTE_SCHED == 1
+                         schedNote(pitchQ4(soundingNote(), midi_pitch_bend_val), 0, TB3R);
+                     #else
+                         pitchOut(pitchQ4(soundingNote(), midi_pitch_bend_val));
+                     #endif
                  }
              }
 
+             // CV input, sounds while no MIDI note is held, again once MIDI let go of the output
+             #if CV_IN == 1
+                 if (cvService()) f_cv_resound = 1;
+                 if (midi_notes[0].on) f_cv_resound = 1;
+                 #if ENV_OUT == 1
+                 else if (f_cv_resound && !f_env_release)  // after the release has muted
+                 #else
+                 else if (f_cv_resound)
+                 #endif
+                 {
+                     f_cv_resound = 0;
+                     #if NOTE_SCHED == 1
+                         schedNote(pitchQ4(cv_note, midi_pitch_bend_val), 1, TB3R);
+                     #else
+                         pitchOut(pitchQ4(cv_note, midi_pitch_bend_val));
+                         HARD_SYNC_OFF;
+                         #if GATE_OUT == 1
+                             gateOut(1);
+                         #endif
+                     #endif
+
+                     #if DEBUG == 1
+                         sprintf(debug_msg, "CV N = %d\r\n", cv_note);
+                         UCA1IE |= UCTXIE;
+                     #endif
+                 }
+             #endif
+
+             // pitch to MIDI from the frequency counter input
+             #if PITCH_TRACK == 1
+                 trackService();
+             #endif
+
+             // write preset edits back while no note is held
+             if (!midi_notes[0].on) presetFlush();
+
+             // apply a block restored over SysEx
+             if (f_sysex_commit)
+             {
+                 switch (framCommit())
+                 {
+                     case FRAM_BLOCK_CAL:
+                         if (!calValid()) break;
+                         dac_expoff = fram_cal.dac_expoff;
+                         dac_exp    = fram_cal.dac_exp;
+                         dac_fine   = fram_cal.dac_fine;
+                         SET_DAC2(dac_expoff);
+                         SET_DAC1(dac_exp);
+                         break;
+                     case FRAM_BLOCK_CFG:
+                     case FRAM_BLOCK_PRESET:
+                         presetSelect(fram_cfg.program);
+                         break;
+                     case FRAM_BLOCK_TUNING:
+                         mtsBuild();
+                         coalPut(&coal_pitch);      // re-sound a held note
+                         break;
+                     default:
+                         break;
+                 }
+                 f_sysex_commit = 0;
+             }
+
+             // loopback stress run
+             #if MIDI_STRESS == 1
+                 stressService();
+             #endif
+
+             // cycle profile, blocks until printed
+             #if CYCLE_PROFILE == 1
+                 if (f_prof) profReport();
+             #endif
+
+             // measure drift whenever the pitch holds still
+             #if BG_RETUNE == 1
+                 retuneService();
+             #endif
+
          } // end tune or play mode
 	} // end while
 } // end main
 
 
+//******************************************************************************
+// Tune ************************************************************************
+//******************************************************************************
+
+// Start a tune measurement, tuneFail after TUNE_TIMEOUT ticks without a result
+void tuneMeasure(void)
+{
+    tune_meas_start = ctrl_ticks;
+    initFreqCtr();
+}
+
+
+// No edges from the VCO: stop the tune, keep the last calibration and mute
+void tuneFail(void)
+{
+    TB0CTL = 0;
+    TB1CTL = 0;
+    TB1CCTL1 = 0;
+    num_ignored = 0;
+    f_exp_offset_tune = 0;
+    f_exp_scale_tune = 0;
+
+    if (calValid())
+    {
+        dac_expoff = fram_cal.dac_expoff;
+        dac_exp    = fram_cal.dac_exp;
+        SET_DAC2(dac_expoff);
+        SET_DAC1(dac_exp);
+    }
+    SET_DAC0(0);
+    HARD_SYNC_ON;
+    TRACE_EVT(TRACE_TUNE, TRACE_TUNE_FAIL, 0);
+
+    #if DEBUG == 1
+        sprintf(debug_msg, "Tune failed, no signal from the VCO\r\n");
+        UCA1IE |= UCTXIE;
+    #endif
+}
+
+
+//******************************************************************************
+// Note Priority ***************************************************************
+//******************************************************************************
+
+// Index of the note that sounds out of midi_notes[0..top] for the active preset
+unsigned char notePriority(unsigned char top)
+{
+    unsigned char i;
+    unsigned char n = top;      // last note priority
+
+    if (preset->priority == PRIORITY_LOW)
+    {
+        for (i = 0; i < top; i++) if (midi_notes[i].value < midi_notes[n].value) n = i;
+    }
+    else if (preset->priority == PRIORITY_HIGH)
+    {
+        for (i = 0; i < top; i++) if (midi_notes[i].value > midi_notes[n].value) n = i;
+    }
+    return n;
+}
+
+
+// Value of the note currently sounding, only valid while a note is held
+unsigned char soundingNote(void)
+{
+    return midi_notes[notePriority(ptr_note-1)].value;
+}
+
+
+//******************************************************************************
+// MIDI Parsing ****************************************************************
+//******************************************************************************
+
+// Parse every buffered MIDI byte and flag the events for the main loop
+RAM_FUNC(midiParse)
+void midiParse(void)
+{
+    struct midi_msg msg;
+
+    while (midiParseNext(&msg))
+    {
+        unsigned char ch   = msg.status & 0x0F;
+        unsigned char type = msg.status & 0xF0;
+
+        // the unit's channel and every channel of an MPE zone
+        unsigned char mine = (ch == midi_channel || mpe_master[ch] != MPE_NO_ZONE);
+
+        #if MIDI_STRESS == 1
+            stress_parsed++;
+        #endif
+
+        // once ACTIVE SENSING was seen, every message restarts the timeout
+        if (msg.status == MIDI_ACTIVE_SENSING) f_sensing = 1;
+        if (f_sensing) timerArm(&sensing_timer, SENSING_TIMEOUT, 0, sensingTimeout);
+
+        // real-time and SysEx bytes, bends and pressure streams would flush the trace in no time
+        if ((msg.status < MIDI_SYS_EXCLUSIVE || (msg.status > MIDI_SYS_EXCLUSIVE && msg.status < MIDI_CLOCK_SYNC))
+            && type != MIDI_PITCH_BEND_BASE && type != MIDI_CH_PRESSURE_BASE && type != MIDI_KEY_PRESSURE_BASE)
+            TRACE_EVT(TRACE_MIDI, msg.status, msg.data[0] | ((unsigned int)msg.data[1] << 8));
+
+        // Note On or Note Off if velocity = 0 (as in Organelle)
+        if (mine && type == MIDI_NOTE_ON_BASE)
+        {
+            midi_note_val = msg.data[0];
+            midi_note_vel = msg.data[1];
+            midi_note_ch  = ch;
+            #if NOTE_SCHED == 1
+                midi_note_time = msg.time;
+            #endif
+            if (midi_note_vel == 0) f_midi_note_off = 4;
+            else                    f_midi_note_on  = 4;
+        }
+
+        // Note Off
+        else if (mine && type == MIDI_NOTE_OFF_BASE)
+        {
+            midi_note_val = msg.data[0];
+            midi_note_vel = msg.data[1];
+            midi_note_ch  = ch;
+            #if NOTE_SCHED == 1
+                midi_note_time = msg.time;
+            #endif
+            f_midi_note_off = 4;
+        }
+
+        // Pitch Bend
+        else if (mine && type == MIDI_PITCH_BEND_BASE)
+        {
+            // full 14-bit value centered about 2^13 for -8192 to +8191 range
+            int bend = ((int)(msg.data[1]) << 7) + (int)(msg.data[0]) - 8192;
+
+            // per-note on an MPE member channel, otherwise for every note
+            if (mpeMember(ch)) mpeBendRx(ch, bend);
+            else
+            {
+                midi_pitch_bend_val = bend;
+                coalPut(&coal_pitch);
+            }
+        }
+
+        // Channel Pressure, per note on an MPE member channel
+        else if (mine && type == MIDI_CH_PRESSURE_BASE)
+        {
+            mpePressureRx(ch, msg.data[0]);
+        }
+
+        // Control Change, RPN/NRPN and channel mode messages, channels 1 and 16 for the MPE configuration
+        else if (type == MIDI_CONTROL_CHANGE_BASE && (mine || ch == MPE_LOWER_MASTER || ch == MPE_UPPER_MASTER))
+        {
+            ccRx(ch, msg.data[0], msg.data[1]);
+        }
+
+        // Tune Request, tune from the main loop
+        else if (msg.status == MIDI_TUNE_REQUEST)
+        {
+            f_tune_request = 1;
+        }
+
+        // Program Change, switch presets
+        else if (msg.status == MIDI_PROGRAM_CHANGE_BASE + midi_channel)
+        {
+            presetSelect(msg.data[0]);
+        }
+
+        // SysEx dump and restore, streamed a byte at a time
+        else if (msg.status == MIDI_SYS_EXCLUSIVE)
+        {
+            sysexRx(msg.data[0]);
+        }
+    }
+}
+
+
+// ACTIVE SENSING timed out, the connection is lost: silence the VCO and stop watching
+void sensingTimeout(void)
+{
+    f_sensing = 0;
+    f_all_notes_off = 1;
+}
+
+
 //******************************************************************************
 // UART Interrupts ***********************************************************
 //******************************************************************************
 
+// A MIDI byte takes 320 us on the wire and UCA0 holds one byte in UCA0RXBUF
+// while the next is shifted in, so USCI_A0_ISR has one byte time from UCRXIFG
+// to read it before the next byte overruns. Interrupts don't nest, so the
+// worst case wait is the MIDI interrupt for the byte before plus the longest
+// time anything else keeps GIE off:
+//   USCI_A1_ISR      one debug byte out, or a command flag and an echo that never waits
+//   Timer3_B0_ISR    control tick, timer wheel and one envelope step
+//   Timer3_B1_ISR    one gate, trigger or scheduled note edge
+//   Timer1_B1_ISR    one step of the frequency counter, or one pitch tracker stamp
+//   main loop        critical sections of a few words, the preset copy is the longest
+// With CYCLE_PROFILE 'p' reports the longest ISR stretch and checks the sum
+// against one byte time.
+
 // MIDI RX
+RAM_FUNC(USCI_A0_ISR)
 #if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
 #pragma vector=USCI_A0_VECTOR
 __interrupt void USCI_A0_ISR(void)
@@ -328,72 +868,38 @@ void __attribute__ ((interrupt(USCI_A0_VECTOR))) USCI_A0_ISR (void)
     case USCI_NONE: break;
 
     case USCI_UART_UCRXIFG:
-      while(!(UCA0IFG&UCTXIFG));
-      if (UCA0RXBUF != MIDI_CLOCK_SYNC)   // ignore sync clock messages
-      {
-          // Note On or Note Off if velocity = 0 (as in Organelle)
-          if (UCA0RXBUF == MIDI_NOTE_ON_BASE + midi_channel)
-          {
-              f_midi_note_on = 1;
-          }
-          else if (f_midi_note_on == 1)   // Note on value
-          {
-              midi_note_val = UCA0RXBUF;
-              f_midi_note_on = 2;
-          }
-          else if (f_midi_note_on == 2)   // Note on velocity
-          {
-              midi_note_vel = UCA0RXBUF;
-              if (midi_note_vel == 0)
-              {
-                  f_midi_note_on  = 0;
-                  f_midi_note_off = 4;
-              }
-              else f_midi_note_on = 4;
-          }
-
-          // Note Off
-          if (UCA0RXBUF == MIDI_NOTE_OFF_BASE + midi_channel)
-          {
-              f_midi_note_off = 1;
-          }
-          else if (f_midi_note_off == 1)
-          {
-              f_midi_note_off = 2;
-              midi_note_val = UCA0RXBUF;
-          }
-          else if (f_midi_note_off == 2)
-          {
-              f_midi_note_off = 4;
-              midi_note_vel = UCA0RXBUF;
-          }
+    {
+      unsigned int stat = UCA0STATW;     // reading UCA0RXBUF clears UCRXIFG and the error flags
+      unsigned char rx  = UCA0RXBUF;
 
-          // Pitch Bend
-          if (UCA0RXBUF == MIDI_PITCH_BEND_BASE + midi_channel)
-          {
-              f_midi_pitch_bend = 1;
-          }
-          else if (f_midi_pitch_bend == 1)
-          {
-              f_midi_pitch_bend = 2;
-              midi_pitch_bend_val = (int)(UCA0RXBUF) >> 2;   // drop 2 LSBs for 12-bit value
-          }
-          else if (f_midi_pitch_bend == 2)
-          {
-              f_midi_pitch_bend = 4;
-              midi_pitch_bend_val += 32 * (int)(UCA0RXBUF) - 2048;  // add MSB to the 5 LSBs already received and center about 2^11 for -2048 to +2047 range
-          }
+      PROF_START(prof_rx);
+      if (uartRxCheck(0, stat))
+      {
+      #if MIDI_MERGE == 1
+        midiMergeRx(0, rx);
+      #else
+        midiRxPush(rx);                  // buffer for the parser and THRU
+      #endif
+        midiParse();
       }
+      PROF_END(prof_rx);
       __no_operation();
       break;
+    }
 
-    case USCI_UART_UCTXIFG: break;
+    case USCI_UART_UCTXIFG:
+    #if MIDI_STRESS == 1
+      stressTxNext();                    // loopback stress pattern
+    #else
+      midiTxNext();                      // THRU or SysEx reply byte
+    #endif
+      break;
     case USCI_UART_UCSTTIFG: break;
     case USCI_UART_UCTXCPTIFG: break;
   }
 }
 
-// Debug RX & TX
+// Debug RX & TX, or the second MIDI RX with MIDI_MERGE
 #if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
 #pragma vector=USCI_A1_VECTOR
 __interrupt void USCI_A1_ISR(void)
@@ -408,12 +914,37 @@ void __attribute__ ((interrupt(USCI_A1_VECTOR))) USCI_A1_ISR (void)
     case USCI_NONE: break;
 
     case USCI_UART_UCRXIFG:
-      while(!(UCA1IFG&UCTXIFG));
-      UCA1TXBUF = UCA1RXBUF;
+    {
+      unsigned int stat = UCA1STATW;
+      unsigned char rx  = UCA1RXBUF;
+
+      if (!uartRxCheck(1, stat)) break;
+    #if MIDI_MERGE == 1
+      // second MIDI input
+      midiMergeRx(1, rx);
+      midiParse();
+    #else
+      PROF_START(prof_block);
+      if (rx == 't') f_tune_request = 1;    // tune on demand
+      #if MIDI_STRESS == 1
+          if (rx == 's') stressStart();     // MIDI input stress run
+      #endif
+      #if PITCH_VERIFY == 1
+          if (rx == 'v') f_verify_request = 1;  // pitch verification sweep
+      #endif
+      #if CYCLE_PROFILE == 1
+          if (rx == 'p') f_prof = 1;        // cycle profile
+      #endif
+      if (UCA1IFG & UCTXIFG) UCA1TXBUF = rx;    // echo, dropped rather than waited for during a debug line
+      PROF_END(prof_block);
+    #endif
       __no_operation();
       break;
+    }
 
     case USCI_UART_UCTXIFG:
+    #if DEBUG == 1
+      PROF_START(prof_block);
       // Transmit the byte
       if(f_print_start)
       {
@@ -437,7 +968,8 @@ void __attribute__ ((interrupt(USCI_A1_VECTOR))) USCI_A1_ISR (void)
               TXbytes = 0;
           }
       }
-
+      PROF_END(prof_block);
+    #endif
       break;
 
     case USCI_UART_UCSTTIFG: break;
@@ -446,6 +978,67 @@ void __attribute__ ((interrupt(USCI_A1_VECTOR))) USCI_A1_ISR (void)
 }
 
 
+// Timer B3 CCR0 interrupt service routine, control tick
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMER3_B0_VECTOR
+__interrupt void Timer3_B0_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMER3_B0_VECTOR))) Timer3_B0_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    PROF_START(prof_block);
+    TB3CCR0 += CTRL_TICK_CNT;           // next tick, no drift from interrupt latency
+    if (++ctrl_ticks == 0) TRACE_EVT(TRACE_WRAP, 0, 0);
+    timerTick();
+    #if CV_IN == 1
+        cvTick();
+    #endif
+
+    // GIE stays off, a scheduled note or release from Timer3_B1_ISR must not
+    // land in the middle of the envelope step, which has a short fixed cost
+    #if ENV_OUT == 1
+        // newest pressure of the sounding note, once per tick
+        if (coalTake(&coal_pressure)) envPressure(mpe_pressure[mpe_out_ch]);
+        envTick();
+    #endif
+    PROF_END(prof_block);
+}
+
+
+// Timer B3 CCR1-CCR6 interrupt service routine, trigger edges on CCR2, note events on CCR3
+#if GATE_OUT == 1 || NOTE_SCHED == 1
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMER3_B1_VECTOR
+__interrupt void Timer3_B1_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMER3_B1_VECTOR))) Timer3_B1_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    PROF_START(prof_block);
+    switch(__even_in_range(TB3IV, TB3IV_TBIFG))
+    {
+    #if GATE_OUT == 1
+        case TB3IV_TBCCR2:
+            gateTrigEdge();
+            break;
+    #endif
+    #if NOTE_SCHED == 1
+        case TB3IV_TBCCR3:
+            schedFire();
+            break;
+    #endif
+        default:
+            break;
+    }
+    PROF_END(prof_block);
+}
+#endif
+
+
 // Timer B1 interrupt service routine
 #if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
 #pragma vector = TIMER1_B1_VECTOR
@@ -456,10 +1049,18 @@ void __attribute__ ((interrupt(TIMER1_B0_VECTOR))) Timer1_B0_ISR (void)
 #error Compiler not supported!
 #endif
 {
+    PROF_START(prof_block);
     switch(__even_in_range(TB1IV, TB1IV_TBIFG))
     {
         case TB1IV_TBIFG:
-            if (num_ignored == 5)
+        #if PITCH_TRACK == 1
+            if (f_track)
+            {
+                trackEdge();        // the pitch tracker owns the counter
+                break;
+            }
+        #endif
+            if (num_ignored == NUM_IGNORED)
             {
                 if (f_exp_offset_tune == 2)
                 {
@@ -491,6 +1092,56 @@ void __attribute__ ((interrupt(TIMER1_B0_VECTOR))) Timer1_B0_ISR (void)
                     f_exp_scale_tune = f_exp_scale_tune * 2;    // advance f_exp_scale_tune flag
                     num_ignored = 0;
                 }
+            #if PITCH_VERIFY == 1
+                else if (f_verify == 2)
+                {
+                    TB0CTL |= MC_2;         // start measuring
+                    TB1R = 0 - meas_periods;    // overflow after meas_periods edges
+                    f_verify = 4;
+                }
+                else if (f_verify == 4)
+                {
+                    TB0CTL = 0;             // stop measuring
+                    TB1CTL = 0;
+                    TB1CCTL1 = 0;
+                    t_meas = TB0R;
+                    SET_DAC0(verify_next_dac);  // next note settles while this one is reported
+                    f_verify = 8;
+                    num_ignored = 0;
+                }
+            #endif
+            #if PITCH_FINE_DAC == 1
+                else if (f_fine_cal == 2)
+                {
+                    TB0CTL |= MC_2;         // start measuring
+                    TB1R = 0 - meas_periods;    // overflow after meas_periods edges
+                    f_fine_cal = 4;
+                }
+                else if (f_fine_cal == 4)
+                {
+                    TB0CTL = 0;             // stop measuring
+                    TB1CTL = 0;
+                    TB1CCTL1 = 0;
+                    t_meas = TB0R;
+                    f_fine_cal = 8;
+                    num_ignored = 0;
+                }
+            #endif
+                else if (f_bg_tune == 2)
+                {
+                    TB0CTL |= MC_2;         // start measuring
+                    TB1R = 0 - meas_periods;    // overflow after meas_periods edges
+                    f_bg_tune = 4;
+                }
+                else if (f_bg_tune == 4)
+                {
+                    TB0CTL = 0;             // stop measuring
+                    TB1CTL = 0;
+                    TB1CCTL1 = 0;
+                    t_meas = TB0R;
+                    f_bg_tune = 8;
+                    num_ignored = 0;
+                }
             }
             else
             {
@@ -503,5 +1154,5 @@ void __attribute__ ((interrupt(TIMER1_B0_VECTOR))) Timer1_B0_ISR (void)
             break;
 
     }
-
+    PROF_END(prof_block);
 }
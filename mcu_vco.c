@@ -5,23 +5,24 @@
  *      Author: tyler
  */
 
+#include <cfg.h>
 #include <mcu_vco.h>
 
-// Initialize CPU clock to 16 MHz
-void initClockTo16MHz()
+// Initialize MCLK and SMCLK to MCLK_FREQ
+void initClock()
 {
-    // Configure one FRAM waitstate as required by the device datasheet for MCLK
+    // Configure the FRAM waitstates required by the device datasheet for MCLK
     // operation beyond 8MHz _before_ configuring the clock system.
-    FRCTL0 = FRCTLPW | NWAITS_1;
+    FRCTL0 = FRCTLPW | CLK_NWAITS;
 
     __bis_SR_register(SCG0);    // disable FLL
     CSCTL3 |= SELREF__REFOCLK;  // Set REFO as FLL reference source
     CSCTL0 = 0;                 // clear DCO and MOD registers
     CSCTL1 &= ~(DCORSEL_7);     // Clear DCO frequency select bits first
-    CSCTL1 |= DCORSEL_5;        // Set DCO = 16MHz
-    CSCTL2 = FLLD_0 + 487;      // set to fDCOCLKDIV = (FLLN + 1)*(fFLLREFCLK/n)
-                                //                   = (487 + 1)*(32.768 kHz/1)
-                                //                   = 16 MHz
+    CSCTL1 |= CLK_DCORSEL;      // Set DCO range for MCLK_FREQ
+    CSCTL2 = FLLD_0 + CLK_FLLN; // set to fDCOCLKDIV = (FLLN + 1)*(fFLLREFCLK/n)
+                                //                   = (MCLK_FREQ/32768)*(32.768 kHz/1)
+                                //                   = MCLK_FREQ
     __delay_cycles(3);
     __bic_SR_register(SCG0);                        // enable FLL
     while(CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1));      // FLL locked
@@ -45,19 +46,29 @@ void initUARTs()
 {
     // A0 = MIDI UART
     UCA0CTLW0 |= UCSWRST;                     // Put eUSCI in reset when making changes
-    UCA0CTLW0 |= UCSSEL__SMCLK;               // CLK = SMCLK
-    UCA0BRW = 32;                             // Baud Rate calculation: (16 MHz)/(16)/(31250) = 32
-    UCA0MCTLW |= UCOS16;                      // enable 16 clock oversampling
+    UCA0CTLW0 |= UCSSEL__SMCLK | UCRXEIE;     // CLK = SMCLK, bytes with a framing error interrupt too
+    UCA0BRW = UART_BRW(MIDI_BAUD);            // UCBRx = SMCLK/16/31250, 32 at 16 MHz and 48 at 24 MHz
+    UCA0MCTLW = UART_MCTLW(MIDI_BAUD);        // 16 clock oversampling, UCBRFx = UART_BRF, 0 at either MCLK_FREQ
     UCA0CTLW0 &= ~UCSWRST;                    // Initialize eUSCI
     UCA0IE |= UCRXIE;                         // Enable USCI_A0 RX interrupt
 
-    // A1 = Debug UART
-    UCA1CTLW0 |= UCSWRST;                     // Put eUSCI in reset when making changes
-    UCA1CTLW0 |= UCSSEL__SMCLK;               // CLK = SMCLK
-    UCA1BRW = 8;                              // Baud Rate Setting: Use MSP430 family ref manual
-    UCA1MCTLW |= UCOS16 | UCBRF_10 | 0xF700;  //0xF700 is UCBRSx = 0xF7
-    UCA1CTLW0 &= ~UCSWRST;                    // Initialize eUSCI
-    UCA1IE |= UCRXIE;                         // Enable USCI_A1 RX interrupt
+    #if MIDI_MERGE == 1
+        // A1 = second MIDI UART
+        UCA1CTLW0 |= UCSWRST;                 // Put eUSCI in reset when making changes
+        UCA1CTLW0 |= UCSSEL__SMCLK | UCRXEIE; // CLK = SMCLK, bytes with a framing error interrupt too
+        UCA1BRW = UART_BRW(MIDI_BAUD);        // UCBRx = SMCLK/16/31250, 32 at 16 MHz and 48 at 24 MHz
+        UCA1MCTLW = UART_MCTLW(MIDI_BAUD);    // 16 clock oversampling, UCBRFx = UART_BRF, 0 at either MCLK_FREQ
+        UCA1CTLW0 &= ~UCSWRST;                // Initialize eUSCI
+        UCA1IE |= UCRXIE;                     // Enable USCI_A1 RX interrupt
+    #else
+        // A1 = Debug UART
+        UCA1CTLW0 |= UCSWRST;                     // Put eUSCI in reset when making changes
+        UCA1CTLW0 |= UCSSEL__SMCLK | UCRXEIE;     // CLK = SMCLK, bytes with a framing error interrupt too
+        UCA1BRW = UART_BRW(DEBUG_BAUD);           // UCBRx = SMCLK/16/115200, 8 at 16 MHz and 13 at 24 MHz
+        UCA1MCTLW = UART_MCTLW(DEBUG_BAUD);       // UCBRFx = UART_BRF and UCBRSx = UART_BRS from MCLK_FREQ
+        UCA1CTLW0 &= ~UCSWRST;                    // Initialize eUSCI
+        UCA1IE |= UCRXIE;                         // Enable USCI_A1 RX interrupt
+    #endif
 }
 
 // Set pin directions
@@ -69,12 +80,27 @@ void initGPIO()
 
     // DACs
     DAC0_OUT_EN;
+    #if ENV_OUT == 1
+        DAC3_OUT_EN;                          // envelope out on P3.5
+    #elif PITCH_FINE_DAC == 1
+        DAC3_OUT_EN;                          // fine pitch out on P3.5, summed into the pitch CV
+    #endif
 
     // Configure GPIO
-    P1SEL1 &= ~(BIT6);                        // USCI_A0 UART operation (RXD only)
-    P1SEL0 |= BIT6;
+    P1SEL1 &= ~(BIT6 | BIT7);                 // USCI_A0 UART operation (RXD, TXD for THRU and SysEx)
+    P1SEL0 |= BIT6 | BIT7;
     P1DIR  |= BIT4;                           // P1.4 is HARD SYNC output
 
+    #if GATE_OUT == 1
+        P6SEL0 |= BIT0 | BIT1;                // P6.0 gate and P6.1 trigger from TB3.1 and TB3.2
+        P6DIR  |= BIT0 | BIT1;
+    #endif
+
+    #if CV_IN == 1
+        P1SEL0 |= BIT2;                       // P1.2 is the CV input on A2
+        P1SEL1 |= BIT2;
+    #endif
+
     P2SEL0 |= BIT2;                           // P2.2 selected as TB1CLK
 
     P4SEL1 &= ~(BIT2 | BIT3);                 // USCI_A1 UART operation
@@ -101,18 +127,57 @@ void initDACs()
     DAC0_CFG;
     DAC1_CFG;
     DAC2_CFG;
+    #if ENV_OUT == 1 || PITCH_FINE_DAC == 1
+        DAC3_CFG;
+    #endif
+
+    // TB2.1 and TB2.2 latch the pitch DACs, both compare at the same count
+    #if PITCH_FINE_DAC == 1
+        TB2CCR1 = 4;
+        TB2CCR2 = 4;
+    #endif
 }
 
 
+#if PITCH_FINE_DAC == 1
+// Load coarse DAC0 and fine DAC3 and latch both at once
+RAM_FUNC(setPitchDAC)
+void setPitchDAC(unsigned int coarse, unsigned int fine)
+{
+    unsigned short state;
+
+    // the tune ISR moves the DAC too
+    state = __get_interrupt_state();
+    __disable_interrupt();
+
+    // stop TB2 and pull both latch signals low, OUTMOD_0 drives OUT = 0
+    TB2CTL   = 0;
+    TB2CCTL1 = OUTMOD_0;
+    TB2CCTL2 = OUTMOD_0;
+
+    SAC0DAT = coarse;
+    SAC3DAT = fine;
+
+    // set both at TB2CCR1 = TB2CCR2, they stay high so nothing latches again
+    TB2CCTL1 = OUTMOD_1;
+    TB2CCTL2 = OUTMOD_1;
+    TB2CTL   = TBSSEL_2 | MC_2 | TBCLR;
+
+    __set_interrupt_state(state);
+}
+#endif
+
+
 // Initialize midi note stack to empty
 void initMIDINotes(struct note *notes)
 {
     // loop through each note and set values to defaults
     unsigned int i;
-    for (i=sizeof(notes)-1; i>0 ; i--)
+    for (i=0; i < SIZE_NOTE_STACK; i++)
     {
         notes[i].value    =  0;
         notes[i].velocity =  0;
+        notes[i].channel  =  0;
         notes[i].on       =  0;
         sprintf(notes[i].name, "");
     }
@@ -140,7 +205,47 @@ void initFreqCtr()
     TB0EX0 = TBIDEX_7;  // divide by 8
 
     // 5. Apply desired configuration to TBxCTL including the MC bits
-    TB0CTL =  ID_3 | TBSSEL_2;         // divide by 8, use SMCLK
+    TB0CTL =  ID_3 | TBSSEL_2;         // divide by 8, use SMCLK: TUNE_CLK_FREQ = SMCLK/64
     TB1CTL = TBSSEL_0 | MC_2 | TBIE;          // TBR1CLK, continuous mode
 }
 
+
+#if PITCH_TRACK == 1
+// Start the frequency counter as the edge time base of the pitch tracker
+void initTrackCtr()
+{
+    TB0CTL = TBCLR;
+    TB1CTL = TBCLR;
+    TB1CCTL1 = 0;
+
+    TB1R = 0xFFFF;                          // overflow on the first edge
+    TB0EX0 = TBIDEX_1;                      // divide by 2
+    TB0CTL = ID_3 | TBSSEL_2 | MC_2;        // divide by 8, SMCLK, runs free: TRACK_CLK_FREQ = SMCLK/16
+    TB1CTL = TBSSEL_0 | MC_2 | TBIE;        // TB1CLK, continuous mode
+}
+#endif
+
+
+// Start the TB3 control tick, CCR0 is moved on by CTRL_TICK_CNT in its interrupt
+void initCtrlTimer()
+{
+    TB3CTL = TBCLR;
+    TB3CCR0 = CTRL_TICK_CNT;
+    TB3CCTL0 = CCIE;                    // compare interrupt on CCR0
+    TB3CCTL1 = OUTMOD_0;                // gate low, OUT = 0
+    TB3CCTL2 = OUTMOD_0;                // trigger low
+    TB3CTL = TBSSEL_2 | MC_2;           // SMCLK, continuous mode so TB3R runs free
+}
+
+
+#if CV_IN == 1
+// Configure the ADC for the CV input on A2, conversions are started by the control tick
+void initADC()
+{
+    ADCCTL0 = ADCSHT_2 | ADCON;         // 16 ADCCLK sample time, ADC on
+    ADCCTL1 = ADCSHP;                   // sample timer, started by ADCSC, single conversion
+    ADCCTL2 = ADCRES_2;                 // 12 bit
+    ADCMCTL0 = ADCINCH_2 | ADCSREF_1;   // A2 against the internal reference of the DACs
+    ADCCTL0 |= ADCENC;
+}
+#endif
@@ -8,6 +8,7 @@
  */
 
 #include <msp430.h>
+#include <cfg.h>
 #include <float.h>
 #include <stdio.h>
 
@@ -25,17 +26,19 @@
 #define VOLTS_PER_NOTE   0.083333333  // (1 V)/(12 notes per octave) = 0.0833333
 #define CV_SCALE         0.25         // to achieve 10 octaves, scale 10V (max note) to 2.5V (max DAC out)
 
-#define MAX_PITCH_BEND   2            // the max notes the pitch bend wheel goes up or down to
-#define DAC_ADJ_SCALE    0.033203125  // difference in DAC between notes = 34
-                                      // pitch bend range is -2048 to 2047
-                                      // DAC_ADJ_SCALE = DAC_diff_between_notes * MAX_PITCH_BEND / MAX_PITCH_BEND_RANGE
+#define MAX_PITCH_BEND   2            // default notes the pitch bend wheel goes up or down to
+#define DAC_Q4_PER_NOTE  546          // difference in DAC between notes = 4095/120 = 34.125, in 1/16 LSB
 #define DAC_OUT_1V25     2047         // DAC value for 1.25V initial EXP SCALE
-#define TUNE_CLK_FREQ    250000       // 250 kHz tune timer clock
-#define CNT_AT_440       568          // desired count value for 440 Hz at A4
-#define TUNE_FREQ_TOL    1            // tune to within +/- 1 Hz
+#define TUNE_CLK_FREQ    (SMCLK_FREQ / 64)          // tune timer clock, 250 kHz at 16 MHz
+#define CNT_AT_440       (TUNE_CLK_FREQ / 440)      // desired count value for 440 Hz at A4, 568 at 16 MHz
+#define TUNE_FREQ_TOL    1            // tune to within +/- 1 count at 440 Hz
 #define INIT_EXP_OFFSET  940          // initial tune value for EXP FREQ offset
-#define CNT_AT_0V        30578        // desired count at 0V for a midi note 0 frequency of 8.1758 Hz
-#define CNT_AT_0V_TOL    20           // measure to within desired count +/-20  clocks
+#define NUM_IGNORED      5            // VCO periods ignored before a measurement starts
+#define CNT_AT_0V        ((TUNE_CLK_FREQ * 10000UL) / 81758)   // desired count at 0V for a midi note 0 frequency of 8.1758 Hz, 30578 at 16 MHz
+#define CNT_AT_0V_TOL    (CNT_AT_0V / 1500)         // measure to within desired count +/-0.07%, 20 clocks at 16 MHz
+#define CTRL_TICK_HZ     1000         // control rate of the envelope and the timer wheel
+#define CTRL_TICK_CNT    ((unsigned int)(SMCLK_FREQ / CTRL_TICK_HZ))    // SMCLK cycles per control tick
+#define SENSING_TIMEOUT  300          // ticks without MIDI after ACTIVE SENSING before all notes off
 
 #define HEADER "\033[2J\033[2H"                                                                   \
                "  __                              __\r\n"                                         \
@@ -49,6 +52,77 @@
 
 
 
+//******************************************************************************
+// Clock Config ****************************************************************
+//******************************************************************************
+
+#define SMCLK_FREQ       MCLK_FREQ
+#define CLK_FLLN         (MCLK_FREQ / 32768 - 1)    // fDCOCLKDIV = (FLLN + 1)*(32.768 kHz), 487 at 16 MHz
+
+#if MCLK_FREQ == 16000000
+    #define CLK_DCORSEL  DCORSEL_5                  // DCO range 16 MHz
+    #define CLK_NWAITS   NWAITS_1                   // one FRAM wait state above 8 MHz
+#elif MCLK_FREQ == 24000000
+    #define CLK_DCORSEL  DCORSEL_7                  // DCO range 24 MHz
+    #define CLK_NWAITS   NWAITS_2                   // two FRAM wait states above 16 MHz
+#else
+    #error Set MCLK_FREQ to 16000000 or 24000000
+#endif
+
+// Run a function from RAM with RAM_HOT_PATH, copied from FRAM at boot so it
+// never waits on FRAM. TI puts it in .TI.ramfunc, copied through the BINIT
+// table, IAR has __ramfunc, GCC copies .data.* with the initialized data.
+// Everything the MIDI RX interrupt and midiParse call per message is marked,
+// only the rare RPN data entry, Program Change and SysEx paths run from FRAM.
+#if RAM_HOT_PATH == 1
+    #if defined(__TI_COMPILER_VERSION__)
+        #if __TI_COMPILER_VERSION__ < 15009000
+            #error RAM_HOT_PATH needs .TI.ramfunc, compiler 15.9.0 or later
+        #endif
+        #define RAM_PRAGMA(x)       _Pragma(#x)
+        #define RAM_FUNC(func)      RAM_PRAGMA(CODE_SECTION(func, ".TI.ramfunc"))
+    #elif defined(__IAR_SYSTEMS_ICC__)
+        #define RAM_FUNC(func)      __ramfunc
+    #elif defined(__GNUC__)
+        #define RAM_FUNC(func)      __attribute__((section(".data.ram_text")))
+    #else
+        #error Compiler not supported!
+    #endif
+#else
+    #define RAM_FUNC(func)
+#endif
+
+#define MIDI_BAUD        31250
+#define DEBUG_BAUD       115200
+
+// UCOS16 divider settings, as in the family user's guide:
+//   N = SMCLK/baud, UCBRx = INT(N/16), UCBRFx = INT(N) mod 16,
+//   UCBRSx from the fractional part of N (in 1/10000) by the UCBRSx table
+#define UART_BRW(baud)   (SMCLK_FREQ / 16 / (baud))
+#define UART_BRF(baud)   ((SMCLK_FREQ / (baud)) % 16)
+#define UART_FRAC(baud)  (((SMCLK_FREQ % (baud)) * 10000UL) / (baud))
+#define UART_BRS(baud)   (UART_FRAC(baud) >= 9288 ? 0xFE : UART_FRAC(baud) >= 9170 ? 0xFD : \
+                          UART_FRAC(baud) >= 9004 ? 0xFB : UART_FRAC(baud) >= 8751 ? 0xF7 : \
+                          UART_FRAC(baud) >= 8572 ? 0xEF : UART_FRAC(baud) >= 8464 ? 0xDF : \
+                          UART_FRAC(baud) >= 8333 ? 0xBF : UART_FRAC(baud) >= 8004 ? 0xEE : \
+                          UART_FRAC(baud) >= 7861 ? 0xED : UART_FRAC(baud) >= 7503 ? 0xDD : \
+                          UART_FRAC(baud) >= 7147 ? 0xBB : UART_FRAC(baud) >= 7001 ? 0xB7 : \
+                          UART_FRAC(baud) >= 6667 ? 0xD6 : UART_FRAC(baud) >= 6432 ? 0xB6 : \
+                          UART_FRAC(baud) >= 6254 ? 0xB5 : UART_FRAC(baud) >= 6003 ? 0xAD : \
+                          UART_FRAC(baud) >= 5715 ? 0x6B : UART_FRAC(baud) >= 5002 ? 0xAA : \
+                          UART_FRAC(baud) >= 4378 ? 0x55 : UART_FRAC(baud) >= 4286 ? 0x53 : \
+                          UART_FRAC(baud) >= 4003 ? 0x92 : UART_FRAC(baud) >= 3753 ? 0x52 : \
+                          UART_FRAC(baud) >= 3575 ? 0x4A : UART_FRAC(baud) >= 3335 ? 0x49 : \
+                          UART_FRAC(baud) >= 3000 ? 0x25 : UART_FRAC(baud) >= 2503 ? 0x44 : \
+                          UART_FRAC(baud) >= 2224 ? 0x22 : UART_FRAC(baud) >= 2147 ? 0x21 : \
+                          UART_FRAC(baud) >= 1670 ? 0x11 : UART_FRAC(baud) >= 1430 ? 0x20 : \
+                          UART_FRAC(baud) >= 1252 ? 0x10 : UART_FRAC(baud) >= 1001 ? 0x08 : \
+                          UART_FRAC(baud) >= 835  ? 0x04 : UART_FRAC(baud) >= 715  ? 0x02 : \
+                          UART_FRAC(baud) >= 529  ? 0x01 : 0x00)
+#define UART_MCTLW(baud) (UCOS16 | ((unsigned int)UART_BRF(baud) << 4) | ((unsigned int)UART_BRS(baud) << 8))
+
+
+
 //******************************************************************************
 // LED Config ******************************************************************
 //******************************************************************************
@@ -95,13 +169,22 @@
 // DAC Config ******************************************************************
 //******************************************************************************
 
+// With PITCH_FINE_DAC the pitch DACs 0 and 3 latch SACxDAT on the rising edge
+// of TB2.1 and TB2.2 instead of on the write, so setPitchDAC can load both and
+// then latch them in the same clock
+#if PITCH_FINE_DAC == 1
+    #define DAC_PITCH_LSEL  DACLSEL_2
+#else
+    #define DAC_PITCH_LSEL  DACLSEL_0
+#endif
+
 #define DAC0_OUT_EN                                                                   \
     P1SEL0 |= BIT1;                                /* Select P1.1 as OA0O function */ \
     P1SEL1 |= BIT1;                                /* OA is used as buffer for DAC */
 
 
 #define DAC0_CFG                                                                                                                    \
-    SAC0DAC = DACSREF_1 + DACLSEL_0 + DACIE;       /* Select DAC ref = int vref, DAC trigger = writing SAC0DAT, enable interrupt */ \
+    SAC0DAC = DACSREF_1 + DAC_PITCH_LSEL + DACIE;  /* Select DAC ref = int vref, DAC trigger per DAC_PITCH_LSEL, enable interrupt */  \
     SAC0DAT = 0;                                   /* Set initial DAC output to 0 */                                                \
     SAC0DAC |= DACEN;                              /* Enable DAC */                                                                 \
     SAC0OA = NMUXEN + PMUXEN + PSEL_1 + NSEL_1;    /* Select positive and negative pin input */                                     \
@@ -109,7 +192,11 @@
     SAC0PGA = MSEL_1;                              /* Set OA as buffer mode */                                                      \
     SAC0OA |= SACEN + OAEN                         /* Enable SAC and OA */
 
-#define SET_DAC0(x) SAC0DAT = (x)
+#if PITCH_FINE_DAC == 1
+    #define SET_DAC0(x) setPitchDAC((x), 0)
+#else
+    #define SET_DAC0(x) SAC0DAT = (x)
+#endif
 
 #define DAC1_OUT_EN                                                                    \
     P1SEL0 |= BIT5;                                 /* Select P1.5 as OA1O function */ \
@@ -146,7 +233,7 @@
     P3SEL1 |= BIT5                                 /* OA is used as buffer for DAC */
 
 #define DAC3_CFG                                                                                                                    \
-    SAC3DAC = DACSREF_1 + DACLSEL_0 + DACIE;       /* Select DAC ref = int vref, DAC trigger = writing SAC3DAT, enable interrupt */ \
+    SAC3DAC = DACSREF_1 + DAC_PITCH_LSEL + DACIE;  /* Select DAC ref = int vref, DAC trigger per DAC_PITCH_LSEL, enable interrupt */  \
     SAC3DAT = 0;                                   /* Set initial DAC output to 0 */                                                \
     SAC3DAC |= DACEN;                              /* Enable DAC */                                                                 \
     SAC3OA = NMUXEN + PMUXEN + PSEL_1 + NSEL_1;    /* Select positive and negative pin input */                                     \
@@ -181,6 +268,7 @@
 struct note {
     unsigned char value;
     unsigned char velocity;
+    unsigned char channel;      // MIDI channel the note arrived on, MPE member or the unit's
     unsigned char on;
     char name[SIZE_NOTE_NAME];
 };
@@ -191,12 +279,16 @@ struct note {
 // Function Definitions ********************************************************
 //******************************************************************************
 
-void initClockTo16MHz(void);                            // Initialize CPU clock to 16 MHz
+void initClock(void);                                   // Initialize MCLK and SMCLK to MCLK_FREQ
 void initUARTs(void);                                   // Configure USCI_A0 & A1 for UART mode
 void initGPIO(void);                                    // Set pin directions
 void initDACs(void);                                    // Initialize DACs
 void initMIDINotes(struct note *notes);                 // Return empty MIDI note stack
 void initFreqCtr(void);                                 // Initialize the frequency counter and pin
+void initCtrlTimer(void);                               // Start the TB3 control tick
+void initTrackCtr(void);                                // Start the frequency counter as the edge time base of the pitch tracker
+void initADC(void);                                     // Configure the ADC for the CV input on A2
+void setPitchDAC(unsigned int coarse, unsigned int fine);   // Load coarse DAC0 and fine DAC3 and latch both at once
 
 
 #endif /* MCU_VCO_H_ */
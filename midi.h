@@ -19,6 +19,25 @@
 #define MIDI_CH_PRESSURE_BASE       0xD0  // channel pressure (aftertouch) used to send single greatest pressue of all current depressed keys followed by value (vvvvvvvv)
 #define MIDI_PITCH_BEND_BASE        0xE0  // 14-bit pitch bend value followed by LSB (0lllllll) then MSB (0mmmmmmm)
 
+// Control change numbers
+#define MIDI_CTL_MOD_WHEEL          1     // modulation wheel MSB, LSB on 33
+#define MIDI_CTL_14BIT_NUM          32    // controllers 0-31 take their LSB on controller + 32
+#define MIDI_CTL_DATA_ENTRY         6     // data entry MSB for the selected RPN or NRPN
+#define MIDI_CTL_DATA_ENTRY_LSB     38    // data entry LSB
+#define MIDI_CTL_DATA_INC           96    // data increment, value ignored
+#define MIDI_CTL_DATA_DEC           97    // data decrement, value ignored
+#define MIDI_CTL_NRPN_LSB           98    // non-registered parameter number LSB
+#define MIDI_CTL_NRPN_MSB           99    // non-registered parameter number MSB
+#define MIDI_CTL_RPN_LSB            100   // registered parameter number LSB
+#define MIDI_CTL_RPN_MSB            101   // registered parameter number MSB
+
+// Registered parameter numbers, MSB << 7 | LSB
+#define MIDI_RPN_BEND_RANGE         0x0000  // pitch bend sensitivity, MSB semitones and LSB cents
+#define MIDI_RPN_FINE_TUNE          0x0001  // channel fine tuning, 14-bit centered on 0x2000 for +/- 100 cents
+#define MIDI_RPN_COARSE_TUNE        0x0002  // channel coarse tuning, MSB semitones centered on 64
+#define MIDI_RPN_MPE_CONFIG         0x0006  // MPE configuration message on channel 1 or 16, MSB member channels
+#define MIDI_RPN_NULL               0x3FFF  // deselects the parameter so data entry is ignored
+
 // Channel mode messages
 #define MIDI_MODE_MSG_BASE          0xB0  // same as control change, but for c=120-127,followed by control number (0ccccccc) then value (0vvvvvvv)
 #define MIDI_CTL_ALL_SOUND_OFF      120   // all oscillators turn off and their volume envelopes set to 0 asap, when v=0
@@ -38,6 +57,10 @@
 #define MIDI_TUNE_REQUEST           0xF6  // tune request, requests all analog synthesizers to tune their oscillators
 #define MIDI_SYS_EXCLUSIVE_END      0xF7  // end of System Exclusive message (eg., end of dump)
 
+// Universal System Exclusive IDs, in place of the manufacturer ID
+#define MIDI_SYSEX_NON_REALTIME     0x7E  // followed by device ID, sub-ID#1, sub-ID#2 (eg., MTS bulk tuning dump)
+#define MIDI_SYSEX_REALTIME         0x7F  // followed by device ID, sub-ID#1, sub-ID#2 (eg., MTS single note tuning change)
+
 // System real-time messages
 #define MIDI_CLOCK_SYNC             0xF8  // sent 24x per quarter note when synchronization used
 #define MIDI_START_SEQ              0xFA  // start the current sequence
@@ -0,0 +1,274 @@
+/*
+ * midi_cc.c
+ *
+ * Every control change is handled in constant time as it arrives from the
+ * parser:
+ *   - controllers 0-31 store their MSB and clear the LSB, 32-63 fill in the
+ *     LSB, so a controller sent as a pair reads back with 14-bit resolution
+ *   - CC 101/100 and 99/98 select an RPN or NRPN, data entry (6/38) and
+ *     increment/decrement (96/97) then write the selected parameter
+ *   - ALL SOUND OFF and ALL NOTES OFF flag the main loop to clear the stack
+ *
+ * Values that move the output (bend, MPE bend, pressure) are overwritten in
+ * place and only mark a coalescing slot. The consumer takes the slot at most
+ * once per control tick and applies whatever value is newest then, so a bend
+ * wheel streaming a message every 320 us costs one pitch update per
+ * millisecond. Updates that were overwritten before being applied are
+ * counted in the slot.
+ *
+ * RPN 0 (bend range), RPN 1 (fine tune), RPN 2 (coarse tune) and the NRPNs
+ * are kept in the active preset through presetEdit, so they are written back
+ * to FRAM with the preset and apply to the pitch path on the next update.
+ *
+ * The parameter selection is kept per channel, since an MPE controller sends
+ * its RPNs on every member channel at once. A member channel only takes RPN 0,
+ * the bend range of its zone, and channels 1 and 16 always take RPN 6, the
+ * MPE configuration message, even when they are not the unit's channel.
+ *
+ */
+
+#include <midi_cc.h>
+#include <midi.h>
+#include <preset.h>
+#include <mpe.h>
+#include <mcu_vco.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned int cc_val[NUM_CC_14BIT] = { 0 };
+volatile unsigned char f_all_notes_off = 0;
+struct coal_slot coal_pitch    = { 0, 0 };
+struct coal_slot coal_pressure = { 0, 0 };
+
+// how the parameters of a channel apply
+#define CC_GLOBAL   0       // unit channel or zone master, the preset
+#define CC_MEMBER   1       // MPE member channel, its zone's bend range
+#define CC_MCM      2       // channel 1 or 16 outside a zone, MPE configuration only
+
+// selected parameter of each channel, MSB << 7 | LSB
+static unsigned int param_num[MPE_NUM_CH] = {
+    MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL,
+    MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL, MIDI_RPN_NULL };
+static unsigned int param_nrpn = 0;                 // bit n set if param_num[n] is an NRPN
+
+// state owned by main.c
+extern unsigned char midi_channel;
+extern int midi_pitch_bend_val;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Mark a slot's value as new, counting the one it replaces if that was never applied
+RAM_FUNC(coalPut)
+void coalPut(struct coal_slot *slot)
+{
+    if (slot->dirty) slot->merged++;
+    slot->dirty = 1;
+}
+
+
+// 1 once for each batch of new values, read the value after this so the newest is used
+unsigned char coalTake(struct coal_slot *slot)
+{
+    if (!slot->dirty) return 0;
+    slot->dirty = 0;
+    return 1;
+}
+
+
+// How the parameters of a channel apply, CC_*
+RAM_FUNC(ccRole)
+static unsigned char ccRole(unsigned char ch)
+{
+    if (mpeMember(ch)) return CC_MEMBER;
+    if (ch == midi_channel || mpeMaster(ch)) return CC_GLOBAL;
+    return CC_MCM;
+}
+
+
+// 14-bit value of the parameter selected on a channel, 0xFFFF if it is not supported there
+static unsigned int paramRead(unsigned char ch)
+{
+    unsigned int  num  = param_num[ch];
+    unsigned char role = ccRole(ch);
+
+    if (param_nrpn & (1u << ch))
+    {
+        if (role != CC_GLOBAL) return 0xFFFF;
+        switch (num)
+        {
+            case NRPN_PRIORITY:    return (unsigned int)preset->priority << 7;
+            case NRPN_ENV_ATTACK:  return (unsigned int)preset->env_attack << 7;
+            case NRPN_ENV_DECAY:   return (unsigned int)preset->env_decay << 7;
+            case NRPN_ENV_SUSTAIN: return (unsigned int)preset->env_sustain << 7;
+            case NRPN_ENV_RELEASE: return (unsigned int)preset->env_release << 7;
+            case NRPN_ENV_VEL:     return (unsigned int)preset->env_vel_depth << 7;
+            case NRPN_ENV_MODE:    return (unsigned int)preset->env_mode << 7;
+            case NRPN_CV_SCALE:    return preset->cv_scale;
+            default:               return 0xFFFF;
+        }
+    }
+
+    if (num == MIDI_RPN_MPE_CONFIG)
+        return (ch == MPE_LOWER_MASTER || ch == MPE_UPPER_MASTER) ? (unsigned int)mpeMembers(ch) << 7 : 0xFFFF;
+    if (role == CC_MEMBER) return (num == MIDI_RPN_BEND_RANGE) ? mpeRangeRead(ch) : 0xFFFF;
+    if (role != CC_GLOBAL) return 0xFFFF;
+
+    switch (num)
+    {
+        case MIDI_RPN_BEND_RANGE:  return ((unsigned int)preset->bend_range << 7) | preset->bend_cents;
+        case MIDI_RPN_FINE_TUNE:   return (unsigned int)(preset->fine_tune + 0x2000);
+        case MIDI_RPN_COARSE_TUNE: return (unsigned int)(preset->coarse_tune + 64) << 7;
+        default:                   return 0xFFFF;
+    }
+}
+
+
+// Write a 14-bit value to the parameter selected on a channel, paramRead has checked it applies
+static void paramWrite(unsigned char ch, unsigned int val)
+{
+    struct preset *p;
+    unsigned int  num = param_num[ch];
+    unsigned char msb = val >> 7;
+    unsigned char lsb = val & 0x7F;
+    unsigned char nrpn = (param_nrpn >> ch) & 0x01;
+
+    // MPE parameters are not part of the preset
+    if (!nrpn && num == MIDI_RPN_MPE_CONFIG)
+    {
+        mpeConfig(ch, msb);
+        return;
+    }
+    if (mpeMember(ch))
+    {
+        mpeRange(ch, val);
+        return;
+    }
+
+    p = presetEdit();
+    if (nrpn) switch (num)
+    {
+        case NRPN_PRIORITY:
+            if (msb <= PRIORITY_HIGH) p->priority = msb;
+            break;
+        case NRPN_ENV_ATTACK:  p->env_attack    = msb; break;
+        case NRPN_ENV_DECAY:   p->env_decay     = msb; break;
+        case NRPN_ENV_SUSTAIN: p->env_sustain   = msb; break;
+        case NRPN_ENV_RELEASE: p->env_release   = msb; break;
+        case NRPN_ENV_VEL:     p->env_vel_depth = msb; break;
+        case NRPN_ENV_MODE:
+            if (msb <= ENV_MODE_LEGATO) p->env_mode = msb;
+            break;
+        case NRPN_CV_SCALE:    p->cv_scale = val & 0x0FFF; break;
+        default:
+            break;
+    }
+    else switch (num)
+    {
+        case MIDI_RPN_BEND_RANGE:
+            p->bend_range = msb;
+            p->bend_cents = (lsb < 100) ? lsb : 99;
+            break;
+        case MIDI_RPN_FINE_TUNE:
+            p->fine_tune = (int)val - 0x2000;
+            break;
+        case MIDI_RPN_COARSE_TUNE:
+            p->coarse_tune = (signed char)msb - 64;
+            break;
+        default:
+            break;
+    }
+
+    // recalculate the sounding note
+    coalPut(&coal_pitch);
+}
+
+
+// Data entry MSB, LSB or increment/decrement of one MSB step
+static void paramData(unsigned char ch, unsigned char num, unsigned char val)
+{
+    unsigned int cur = paramRead(ch);
+
+    if (cur == 0xFFFF) return;
+
+    switch (num)
+    {
+        case MIDI_CTL_DATA_ENTRY:     cur = (cur & 0x007F) | ((unsigned int)val << 7);   break;
+        case MIDI_CTL_DATA_ENTRY_LSB: cur = (cur & 0x3F80) | val;                        break;
+        case MIDI_CTL_DATA_INC:       cur = (cur < 0x3F80) ? cur + 0x80 : 0x3FFF;         break;
+        case MIDI_CTL_DATA_DEC:       cur = (cur >= 0x80) ? cur - 0x80 : 0;               break;
+        default:                      return;
+    }
+    paramWrite(ch, cur);
+}
+
+
+// Handle a control change on the unit's channel, an MPE zone channel, or channel 1 or 16
+RAM_FUNC(ccRx)
+void ccRx(unsigned char ch, unsigned char num, unsigned char val)
+{
+    unsigned char role = ccRole(ch);
+
+    switch (num)
+    {
+        case MIDI_CTL_RPN_MSB:
+            param_num[ch] = (param_num[ch] & 0x007F) | ((unsigned int)val << 7);
+            param_nrpn &= ~(1u << ch);
+            break;
+        case MIDI_CTL_RPN_LSB:
+            param_num[ch] = (param_num[ch] & 0x3F80) | val;
+            param_nrpn &= ~(1u << ch);
+            break;
+        case MIDI_CTL_NRPN_MSB:
+            param_num[ch] = (param_num[ch] & 0x007F) | ((unsigned int)val << 7);
+            param_nrpn |= 1u << ch;
+            break;
+        case MIDI_CTL_NRPN_LSB:
+            param_num[ch] = (param_num[ch] & 0x3F80) | val;
+            param_nrpn |= 1u << ch;
+            break;
+
+        case MIDI_CTL_DATA_ENTRY:
+        case MIDI_CTL_DATA_ENTRY_LSB:
+        case MIDI_CTL_DATA_INC:
+        case MIDI_CTL_DATA_DEC:
+            if (param_num[ch] != MIDI_RPN_NULL) paramData(ch, num, val);
+            break;
+
+        case MIDI_CTL_ALL_SOUND_OFF:
+        case MIDI_CTL_ALL_NOTES_OFF:
+            if (role != CC_MCM) f_all_notes_off = 1;
+            break;
+
+        case MIDI_CTL_RESET_ALL:
+            // bend and modulation to rest, deselect the parameter (RP-015)
+            param_num[ch] = MIDI_RPN_NULL;
+            if (role == CC_MEMBER)
+            {
+                mpeBendRx(ch, 0);
+                mpePressureRx(ch, 0);
+            }
+            else if (role == CC_GLOBAL)
+            {
+                cc_val[MIDI_CTL_MOD_WHEEL] = 0;
+                midi_pitch_bend_val = 0;
+                coalPut(&coal_pitch);
+            }
+            break;
+
+        default:
+            if (role != CC_GLOBAL) break;
+            // a new MSB clears the LSB so a 7-bit only controller still reads right
+            if (num < MIDI_CTL_14BIT_NUM)
+                cc_val[num] = (unsigned int)val << 7;
+            else if (num < 2 * MIDI_CTL_14BIT_NUM)
+                cc_val[num - MIDI_CTL_14BIT_NUM] = (cc_val[num - MIDI_CTL_14BIT_NUM] & 0x3F80) | val;
+            break;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * midi_cc.h
+ *
+ * Control change handling: 14-bit controller pairs, RPN/NRPN data entry and
+ * channel mode messages
+ *
+ */
+
+#ifndef MIDI_CC_H_
+#define MIDI_CC_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define NUM_CC_14BIT      32        // controllers 0-31 with their LSB on 32-63
+
+// non-registered parameter numbers, MSB << 7 | LSB
+#define NRPN_PRIORITY     0x0001    // note priority of the active preset, MSB = PRIORITY_*
+#define NRPN_ENV_ATTACK   0x0002    // envelope of the active preset, MSB = 0-127
+#define NRPN_ENV_DECAY    0x0003
+#define NRPN_ENV_SUSTAIN  0x0004
+#define NRPN_ENV_RELEASE  0x0005
+#define NRPN_ENV_VEL      0x0006    // envelope velocity depth, MSB = 0-127
+#define NRPN_ENV_MODE     0x0007    // MSB = ENV_MODE_*
+#define NRPN_CV_SCALE     0x0008    // CV input scale, 14-bit value with bit n set for pitch class n (0 = C), 0 = all
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// coalescing slot for a value the ISR overwrites in place, applied at most once per tick
+struct coal_slot {
+    volatile unsigned char dirty;   // a new value waits to be applied
+    unsigned int merged;            // updates overwritten before they were applied
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned int cc_val[NUM_CC_14BIT];       // 14-bit controller values, MSB << 7 | LSB
+extern volatile unsigned char f_all_notes_off;  // ALL NOTES OFF or ALL SOUND OFF received
+extern struct coal_slot coal_pitch;             // bend, tune or MPE bend of the sounding note changed
+extern struct coal_slot coal_pressure;          // pressure of the sounding note changed
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void ccRx(unsigned char ch, unsigned char num, unsigned char val);  // Handle a control change on a channel of the unit
+void coalPut(struct coal_slot *slot);                   // Mark a slot's value as new
+unsigned char coalTake(struct coal_slot *slot);         // 1 once for each batch of new values
+
+
+#endif /* MIDI_CC_H_ */
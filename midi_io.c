@@ -0,0 +1,418 @@
+/*
+ * midi_io.c
+ *
+ * Every received MIDI byte is written once into midi_rx_buf. The parser and the
+ * THRU output each keep their own read index into that buffer, so forwarding
+ * never copies or re-encodes anything. UCA0 TX is shared with the SysEx
+ * replies and the pitch tracker, which are slotted in between forwarded
+ * messages. A local message ends the running status downstream, so the
+ * forwarded status is sent again before the next running status message.
+ *
+ * With MIDI_MERGE the buffer holds the merged stream instead. Each input port
+ * assembles complete messages with its own running status, and only whole
+ * messages are written into the buffer, so the two streams never interleave
+ * inside a message. Real-time bytes are passed on as soon as they arrive.
+ *
+ */
+
+#include <midi_io.h>
+#include <mcu_vco.h>
+#include <midi.h>
+#include <sysex.h>
+#include <mpe.h>
+#include <track.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned char midi_rx_buf[SIZE_MIDI_RX_BUF];
+volatile unsigned char midi_rx_head = 0;        // free running, masked on access
+
+#if NOTE_SCHED == 1
+    unsigned int midi_rx_time[SIZE_MIDI_RX_BUF];
+#endif
+
+unsigned int midi_thru_drops = 0;
+struct uart_errors uart_errors[2];
+
+static unsigned char parse_tail = 0;            // next byte the parser reads
+static struct midi_parser parser;               // assembler for the buffered stream
+
+#if MIDI_MERGE == 1
+    struct midi_port midi_ports[2];
+
+    static unsigned char merge_status = 0;      // running status of the merged stream
+    static unsigned char merge_owner  = 0;      // port + 1 while that port streams a SysEx
+    static unsigned int  merge_clock  = 0;      // bytes written to the merged stream
+#endif
+
+#if MIDI_THRU != MIDI_THRU_OFF
+    static unsigned char thru_tail   = 0;       // next byte the THRU output reads
+    static unsigned char thru_status = 0;       // running status seen by the THRU filter
+    static unsigned char thru_sent   = 0;       // running status of the forwarded stream
+    static unsigned char thru_left   = 0;       // data bytes left in the forwarded message
+    static unsigned char thru_resend = 0;       // a local message went out, thru_sent is stale downstream
+
+    #define THRU_IN_SYSEX 0xFF                  // thru_left while forwarding a SysEx
+#endif
+
+extern unsigned char midi_channel;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Number of data bytes following a status byte
+RAM_FUNC(midiDataLen)
+unsigned char midiDataLen(unsigned char status)
+{
+    // 0x8n - 0xEn
+    static const unsigned char voice_len[7] = { 2, 2, 2, 2, 1, 1, 2 };
+
+    if (status < MIDI_SYS_EXCLUSIVE) return voice_len[(status >> 4) - 8];
+    if (status == MIDI_SONG_POS_PTR) return 2;
+    if (status == MIDI_TIME_QTR_FRAME || status == MIDI_SONG_SELECT) return 1;
+    return 0;
+}
+
+
+// Feed one byte to a message assembler
+RAM_FUNC(midiAssemble)
+unsigned char midiAssemble(struct midi_parser *p, unsigned char byte)
+{
+    // real-time bytes may sit inside any message and never change running status
+    if (byte >= MIDI_CLOCK_SYNC) return MIDI_ASM_REALTIME;
+
+    // status byte
+    if (byte & 0x80)
+    {
+        if (byte == MIDI_SYS_EXCLUSIVE_END)
+        {
+            unsigned char in_sysex = (p->status == MIDI_SYS_EXCLUSIVE);
+            p->status = 0;
+            return in_sysex ? MIDI_ASM_SYSEX : MIDI_ASM_NONE;
+        }
+
+        p->status = byte;
+        p->count  = 0;
+        if (byte == MIDI_SYS_EXCLUSIVE) return MIDI_ASM_SYSEX;
+
+        p->len = midiDataLen(byte);
+        if (p->len) return MIDI_ASM_NONE;
+
+        // tune request and undefined system common messages carry no data
+        p->msg.status = byte;
+        p->status = 0;
+        return MIDI_ASM_MSG;
+    }
+
+    // data byte
+    if (p->status == 0) return MIDI_ASM_NONE;               // no running status, ignore
+    if (p->status == MIDI_SYS_EXCLUSIVE) return MIDI_ASM_SYSEX;
+
+    p->msg.data[p->count++] = byte;
+    if (p->count < p->len) return MIDI_ASM_NONE;
+
+    p->count = 0;
+    p->msg.status = p->status;
+    if (p->status >= MIDI_SYS_EXCLUSIVE) p->status = 0;     // system common cancels running status
+    return MIDI_ASM_MSG;
+}
+
+
+// Parse buffered bytes until a message or SysEx byte is complete, returns 0 when the buffer is empty
+RAM_FUNC(midiParseNext)
+unsigned char midiParseNext(struct midi_msg *msg)
+{
+    while (parse_tail != midi_rx_head)
+    {
+        unsigned char byte = midi_rx_buf[parse_tail & MIDI_RX_BUF_MASK];
+        #if NOTE_SCHED == 1
+            msg->time = midi_rx_time[parse_tail & MIDI_RX_BUF_MASK];
+        #endif
+        parse_tail++;
+
+        switch (midiAssemble(&parser, byte))
+        {
+            case MIDI_ASM_MSG:
+                #if NOTE_SCHED == 1
+                    parser.msg.time = msg->time;
+                #endif
+                *msg = parser.msg;
+                return 1;
+            case MIDI_ASM_REALTIME:
+                msg->status = byte;
+                return 1;
+            case MIDI_ASM_SYSEX:
+                // SysEx bytes are handed out one at a time as F0 messages
+                msg->status  = MIDI_SYS_EXCLUSIVE;
+                msg->data[0] = byte;
+                return 1;
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+
+// Count the errors of a received byte from UCAxSTATW, read before UCAxRXBUF
+// clears them, 0 if it must be dropped
+RAM_FUNC(uartRxCheck)
+unsigned char uartRxCheck(unsigned char port, unsigned int stat)
+{
+    if (stat & UCOE) uart_errors[port].overruns++;
+    if (stat & UCFE)
+    {
+        uart_errors[port].framing++;
+        return 0;
+    }
+    return 1;
+}
+
+
+// Store a received byte and kick the THRU output
+RAM_FUNC(midiRxPush)
+void midiRxPush(unsigned char byte)
+{
+    midi_rx_buf[midi_rx_head & MIDI_RX_BUF_MASK] = byte;
+    #if NOTE_SCHED == 1
+        midi_rx_time[midi_rx_head & MIDI_RX_BUF_MASK] = TB3R;  // the fixed delay counts from here
+    #endif
+    midi_rx_head++;
+
+    #if MIDI_THRU != MIDI_THRU_OFF
+        // TX runs at the RX baud rate so this only happens if the output stalls
+        if ((unsigned char)(midi_rx_head - thru_tail) > SIZE_MIDI_RX_BUF)
+        {
+            thru_tail++;
+            midi_thru_drops++;
+        }
+        UCA0IE |= UCTXIE;                       // TX interrupt fires at once if UCA0TXBUF is empty
+    #endif
+}
+
+
+#if MIDI_THRU != MIDI_THRU_OFF
+// Decide whether a byte is forwarded
+static unsigned char midiThruPass(unsigned char byte)
+{
+    #if MIDI_THRU == MIDI_THRU_ALL
+        return 1;
+    #else
+        // real-time bytes may sit inside any message and never change running status
+        if (byte >= MIDI_CLOCK_SYNC) return 1;
+        if (byte & 0x80) thru_status = byte;
+
+        // drop channel messages this unit consumes, data bytes follow their status
+        if (thru_status < MIDI_SYS_EXCLUSIVE
+            && ((thru_status & 0x0F) == midi_channel || mpe_master[thru_status & 0x0F] != MPE_NO_ZONE)) return 0;
+        return 1;
+    #endif
+}
+#endif
+
+
+#if MIDI_THRU != MIDI_THRU_OFF
+// Track where the forwarded stream is inside a message
+static void midiThruTrack(unsigned char byte)
+{
+    if (byte >= MIDI_CLOCK_SYNC) return;
+
+    if (byte == MIDI_SYS_EXCLUSIVE)          thru_left = THRU_IN_SYSEX;
+    else if (byte == MIDI_SYS_EXCLUSIVE_END) thru_left = 0;
+    else if (byte & 0x80)
+    {
+        thru_sent = (byte < MIDI_SYS_EXCLUSIVE) ? byte : 0;
+        thru_left = midiDataLen(byte);
+    }
+    else if (thru_left == THRU_IN_SYSEX) return;
+    else if (thru_left) thru_left--;
+    else if (thru_sent) thru_left = midiDataLen(thru_sent) - 1;   // running status
+}
+#endif
+
+
+// Send the next byte on UCA0 TX from the TX interrupt
+void midiTxNext(void)
+{
+    int byte;
+
+    // a pitch tracker message is finished before anything else
+    #if PITCH_TRACK == 1
+        if (trackTxBusy())
+        {
+            UCA0TXBUF = trackTxNext();
+            return;
+        }
+    #endif
+
+    // local messages (SysEx replies, pitch tracker) only start between forwarded messages
+    #if MIDI_THRU != MIDI_THRU_OFF
+    if (thru_left == 0)
+    #endif
+    {
+        byte = sysexTxNext();
+        #if PITCH_TRACK == 1
+            if (byte < 0) byte = trackTxNext();
+        #endif
+        if (byte >= 0)
+        {
+            UCA0TXBUF = byte;
+            #if MIDI_THRU != MIDI_THRU_OFF
+                thru_resend = 1;        // a SysEx or channel message ends the forwarded running status
+            #endif
+            return;
+        }
+    }
+
+    #if MIDI_THRU != MIDI_THRU_OFF
+        while (thru_tail != midi_rx_head)
+        {
+            unsigned char thru = midi_rx_buf[thru_tail & MIDI_RX_BUF_MASK];
+
+            if (!midiThruPass(thru))
+            {
+                thru_tail++;
+                continue;
+            }
+
+            // running status data after a local message, send the status again first
+            if (thru_resend && !(thru & 0x80) && thru_left == 0 && thru_sent)
+            {
+                thru_resend = 0;
+                midiThruTrack(thru_sent);
+                UCA0TXBUF = thru_sent;
+                return;
+            }
+
+            thru_tail++;
+            if (thru >= 0x80 && thru < MIDI_CLOCK_SYNC) thru_resend = 0;
+            midiThruTrack(thru);
+            UCA0TXBUF = thru;
+            return;
+        }
+    #endif
+
+    // nothing left to send
+    UCA0IE &= ~UCTXIE;
+}
+
+#if MIDI_MERGE == 1
+// Write one byte to the merged stream
+static void midiMergeEmit(unsigned char byte)
+{
+    midiRxPush(byte);
+    merge_clock++;
+}
+
+
+// Write a complete message to the merged stream
+static void midiMergeSend(struct midi_port *p, struct midi_msg *msg, unsigned int delay)
+{
+    unsigned char i;
+    unsigned char len = midiDataLen(msg->status);
+
+    // reuse the merged running status where the two ports agree
+    if (msg->status != merge_status || msg->status >= MIDI_SYS_EXCLUSIVE)
+    {
+        midiMergeEmit(msg->status);
+    }
+    merge_status = (msg->status < MIDI_SYS_EXCLUSIVE) ? msg->status : 0;
+
+    for (i = 0; i < len; i++)
+    {
+        midiMergeEmit(msg->data[i]);
+    }
+
+    p->merged++;
+    p->delay_sum += delay;
+    if (delay > p->delay_max) p->delay_max = delay;
+}
+
+
+// Release the merged stream at the end of a SysEx and flush what the other port held back
+static void midiMergeRelease(void)
+{
+    struct midi_port *other = &midi_ports[merge_owner & 1];   // owner is port + 1
+    unsigned char i;
+
+    merge_owner = 0;
+    for (i = 0; i < other->queue_len; i++)
+    {
+        midiMergeSend(other, &other->queue[i], merge_clock - other->queue_stamp[i]);
+    }
+    other->queue_len = 0;
+}
+
+
+// Merge a byte received on one of the two inputs
+void midiMergeRx(unsigned char port, unsigned char byte)
+{
+    struct midi_port *p = &midi_ports[port];
+    unsigned char result = midiAssemble(&p->parser, byte);
+
+    // any status byte other than real-time or F7 ends an open SysEx
+    if (p->in_sysex && (byte & 0x80) && byte != MIDI_SYS_EXCLUSIVE_END && result != MIDI_ASM_REALTIME)
+    {
+        p->in_sysex = 0;
+        if (merge_owner == port + 1)
+        {
+            midiMergeEmit(MIDI_SYS_EXCLUSIVE_END);
+            midiMergeRelease();
+        }
+    }
+
+    switch (result)
+    {
+        case MIDI_ASM_REALTIME:
+            midiMergeEmit(byte);
+            break;
+
+        case MIDI_ASM_SYSEX:
+            if (byte == MIDI_SYS_EXCLUSIVE)
+            {
+                p->in_sysex = 1;
+                if (merge_owner == 0)
+                {
+                    merge_owner  = port + 1;
+                    merge_status = 0;
+                    midiMergeEmit(byte);
+                }
+                else p->dropped++;              // a SysEx can't be held back, drop it
+            }
+            else if (merge_owner == port + 1)
+            {
+                midiMergeEmit(byte);
+                if (byte == MIDI_SYS_EXCLUSIVE_END)
+                {
+                    p->in_sysex = 0;
+                    midiMergeRelease();
+                }
+            }
+            else if (byte == MIDI_SYS_EXCLUSIVE_END) p->in_sysex = 0;
+            break;
+
+        case MIDI_ASM_MSG:
+            if (merge_owner == 0 || merge_owner == port + 1)
+            {
+                midiMergeSend(p, &p->parser.msg, 0);
+            }
+            else if (p->queue_len < SIZE_MERGE_QUEUE)
+            {
+                p->queue[p->queue_len]       = p->parser.msg;
+                p->queue_stamp[p->queue_len] = merge_clock;
+                p->queue_len++;
+            }
+            else p->dropped++;
+            break;
+
+        default:
+            break;
+    }
+}
+#endif
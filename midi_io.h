@@ -0,0 +1,110 @@
+/*
+ * midi_io.h
+ *
+ * MIDI byte stream buffering, message parsing, two port merge and soft THRU
+ *
+ */
+
+#ifndef MIDI_IO_H_
+#define MIDI_IO_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define SIZE_MIDI_RX_BUF  64                      // must be a power of 2 below 256
+#define MIDI_RX_BUF_MASK  (SIZE_MIDI_RX_BUF - 1)
+#define SIZE_MERGE_QUEUE  4                       // messages held per port while the other port owns a SysEx
+
+// midiAssemble results
+#define MIDI_ASM_NONE     0                       // byte consumed, no message yet
+#define MIDI_ASM_MSG      1                       // channel or system common message complete
+#define MIDI_ASM_REALTIME 2                       // single byte real-time message
+#define MIDI_ASM_SYSEX    3                       // byte belongs to a SysEx (F0, data or F7)
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// complete MIDI message
+struct midi_msg {
+    unsigned char status;
+    unsigned char data[2];
+    unsigned int time;                            // TB3R when its last byte arrived, NOTE_SCHED only
+};
+
+// running status message assembler
+struct midi_parser {
+    unsigned char status;                         // running status, 0 if none
+    unsigned char count;                          // data bytes received
+    unsigned char len;                            // data bytes expected
+    struct midi_msg msg;
+};
+
+// receive errors of one UART
+struct uart_errors {
+    unsigned int overruns;                        // UCOE, a byte was lost before UCAxRXBUF was read
+    unsigned int framing;                         // UCFE, the byte was dropped
+};
+
+// merge input port
+struct midi_port {
+    struct midi_parser parser;
+    unsigned char in_sysex;                       // port is inside a SysEx
+    struct midi_msg queue[SIZE_MERGE_QUEUE];      // messages held behind the other port's SysEx
+    unsigned int queue_stamp[SIZE_MERGE_QUEUE];   // merge_clock when each message was held
+    unsigned char queue_len;
+
+    // statistics, UART errors are in uart_errors
+    unsigned int  dropped;                        // messages dropped by the merge
+    unsigned int  merged;                         // messages forwarded
+    unsigned int  delay_max;                      // longest hold in byte times (320 us)
+    unsigned long delay_sum;                      // total hold in byte times
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+// received MIDI bytes, shared by every consumer of the input stream
+extern unsigned char midi_rx_buf[SIZE_MIDI_RX_BUF];
+extern volatile unsigned char midi_rx_head;
+
+#if NOTE_SCHED == 1
+    extern unsigned int midi_rx_time[SIZE_MIDI_RX_BUF];     // TB3R when each byte was received
+#endif
+
+// bytes the THRU output had to drop because it fell a full buffer behind
+extern unsigned int midi_thru_drops;
+
+// receive errors on UCA0 and UCA1, MIDI or debug
+extern struct uart_errors uart_errors[2];
+
+#if MIDI_MERGE == 1
+    extern struct midi_port midi_ports[2];        // 0 = UCA0, 1 = UCA1
+#endif
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+unsigned char midiDataLen(unsigned char status);        // Number of data bytes following a status byte
+unsigned char midiAssemble(struct midi_parser *p, unsigned char byte);  // Feed one byte to a message assembler
+unsigned char midiParseNext(struct midi_msg *msg);      // Parse buffered bytes until a message is complete
+unsigned char uartRxCheck(unsigned char port, unsigned int stat);  // Count the errors of a received byte, 0 if it must be dropped
+void midiRxPush(unsigned char byte);                    // Store a received byte and kick the THRU output
+void midiMergeRx(unsigned char port, unsigned char byte);  // Merge a byte received on one of the two inputs
+void midiTxNext(void);                                  // Send the next byte on UCA0 TX from the TX interrupt
+
+
+#endif /* MIDI_IO_H_ */
@@ -138,105 +138,9 @@ unsigned int conv_midi_to_dac(char note) {
 }
 
 
-unsigned int conv_midi_to_freq(char note) {
-    // MIDI note to frequency value lookup table
-    static const unsigned int freq_lut[121] = {
-      8,
-      9,
-      9,
-      10,
-      10,
-      11,
-      12,
-      12,
-      13,
-      14,
-      15,
-      15,
-      16,
-      17,
-      18,
-      19,
-      21,
-      22,
-      23,
-      24,
-      26,
-      28,
-      29,
-      31,
-      33,
-      35,
-      37,
-      39,
-      41,
-      44,
-      46,
-      49,
-      52,
-      55,
-      58,
-      62,
-      65,
-      69,
-      73,
-      78,
-      82,
-      87,
-      92,
-      98,
-      104,
-      110,
-      117,
-      123,
-      131,
-      139,
-      147,
-      156,
-      165,
-      175,
-      185,
-      196,
-      208,
-      220,
-      233,
-      247,
-      262,
-      277,
-      294,
-      311,
-      330,
-      349,
-      370,
-      392,
-      415,
-      440,
-      466,
-      494,
-      523,
-      554,
-      587,
-      622,
-      659,
-      698,
-      740,
-      784,
-      831,
-      880,
-      932,
-      988,
-      1047,
-      1109,
-      1175,
-      1245,
-      1319,
-      1397,
-      1480,
-      1568,
-      1661,
-      1760,
-      1865,
-      1976,
+unsigned long conv_midi_to_freq(char note) {
+    // MIDI note to frequency lookup table in 1/256 Hz
+    static const unsigned long freq_lut[121] = {
       2093,
       2217,
       2349,
@@ -261,8 +165,104 @@ unsigned int conv_midi_to_freq(char note) {
       7040,
       7459,
       7902,
-      8372   };
+      8372,
+      8870,
+      9397,
+      9956,
+      10548,
+      11175,
+      11840,
+      12544,
+      13290,
+      14080,
+      14917,
+      15804,
+      16744,
+      17740,
+      18795,
+      19912,
+      21096,
+      22351,
+      23680,
+      25088,
+      26580,
+      28160,
+      29834,
+      31609,
+      33488,
+      35479,
+      37589,
+      39824,
+      42192,
+      44701,
+      47359,
+      50175,
+      53159,
+      56320,
+      59669,
+      63217,
+      66976,
+      70959,
+      75178,
+      79649,
+      84385,
+      89402,
+      94719,
+      100351,
+      106318,
+      112640,
+      119338,
+      126434,
+      133952,
+      141918,
+      150356,
+      159297,
+      168769,
+      178805,
+      189437,
+      200702,
+      212636,
+      225280,
+      238676,
+      252868,
+      267905,
+      283835,
+      300713,
+      318594,
+      337539,
+      357610,
+      378874,
+      401403,
+      425272,
+      450560,
+      477352,
+      505737,
+      535809,
+      567670,
+      601425,
+      637188,
+      675077,
+      715219,
+      757749,
+      802807,
+      850544,
+      901120,
+      954703,
+      1011473,
+      1071618,
+      1135340,
+      1202851,
+      1274376,
+      1350154,
+      1430439,
+      1515497,
+      1605613,
+      1701088,
+      1802240,
+      1909407,
+      2022946,
+      2143237   };
 
-    unsigned int freq = freq_lut[note];
+    unsigned long freq = freq_lut[note];
     return freq;
 }
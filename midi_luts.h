@@ -8,7 +8,7 @@
 
 
 unsigned int conv_midi_to_dac(char);
-unsigned int conv_midi_to_freq(char);
+unsigned long conv_midi_to_freq(char);  // frequency in 1/256 Hz
 
 
 #endif /* MIDI_LUTS_H_ */
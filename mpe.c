@@ -0,0 +1,156 @@
+/*
+ * mpe.c
+ *
+ * MPE sends each note on its own member channel, so bend and pressure are
+ * per note. Zones are set up by the MPE configuration message (RPN 6) on
+ * channel 1 (lower zone, members upwards from channel 2) or channel 16
+ * (upper zone, members downwards from channel 15). Every channel's role is
+ * looked up in mpe_master, and bend and pressure are stored per channel, so
+ * a message costs the same whatever the zone layout. Reconfiguring a zone is
+ * the only thing that walks the channels.
+ *
+ * The VCO plays one note at a time, so the notes of every member channel
+ * share the note stack and the one that sounds owns the output. A bend or
+ * pressure message on the owner's channel marks the coalescing slot of
+ * midi_cc.c that updates the output, and the same message on any other
+ * channel is only stored until its note sounds. The master channel bend is
+ * midi_pitch_bend_val with the preset bend range, and member bends add on top
+ * with the zone's own range, 48 semitones by default.
+ *
+ */
+
+#include <mpe.h>
+#include <mcu_vco.h>
+#include <midi_cc.h>
+#include <env.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define ZONE(master)        ((master) == MPE_UPPER_MASTER)   // 0 lower, 1 upper
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned char mpe_master[MPE_NUM_CH] = {
+    MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE,
+    MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE, MPE_NO_ZONE };
+int mpe_bend[MPE_NUM_CH];
+unsigned char mpe_pressure[MPE_NUM_CH];
+unsigned char mpe_out_ch = 0;
+
+static unsigned char zone_members[2] = { 0, 0 };
+static unsigned int  zone_range[2] = { MPE_DEF_RANGE << 7, MPE_DEF_RANGE << 7 };    // RPN 0 value
+static long          zone_scale[2] = {                                              // full bend in 1/16 DAC LSB
+    (long)MPE_DEF_RANGE * DAC_Q4_PER_NOTE, (long)MPE_DEF_RANGE * DAC_Q4_PER_NOTE };
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// MPE configuration message (RPN 6) on a master channel, members = 0 turns the zone off
+void mpeConfig(unsigned char master, unsigned char members)
+{
+    unsigned char z = ZONE(master);
+    unsigned char ch;
+
+    if (members > MPE_MAX_MEMBERS) members = MPE_MAX_MEMBERS;
+    zone_members[z] = members;
+
+    // a zone growing into the other shrinks it, 14 or more members leave no room for it
+    if (zone_members[0] + zone_members[1] > MPE_MAX_MEMBERS - 1)
+        zone_members[!z] = (members >= MPE_MAX_MEMBERS - 1) ? 0 : MPE_MAX_MEMBERS - 1 - members;
+
+    zone_range[z] = MPE_DEF_RANGE << 7;
+    zone_scale[z] = (long)MPE_DEF_RANGE * DAC_Q4_PER_NOTE;
+
+    for (ch = 0; ch < MPE_NUM_CH; ch++)
+    {
+        mpe_master[ch]   = MPE_NO_ZONE;
+        mpe_bend[ch]     = 0;
+        mpe_pressure[ch] = 0;
+    }
+    if (zone_members[0])
+    {
+        for (ch = 0; ch <= zone_members[0]; ch++) mpe_master[MPE_LOWER_MASTER + ch] = MPE_LOWER_MASTER;
+    }
+    if (zone_members[1])
+    {
+        for (ch = 0; ch <= zone_members[1]; ch++) mpe_master[MPE_UPPER_MASTER - ch] = MPE_UPPER_MASTER;
+    }
+
+    // notes on channels that changed roles would never get their note off
+    f_all_notes_off = 1;
+}
+
+
+// Member bend range (RPN 0) received on a member channel, MSB semitones and LSB cents
+void mpeRange(unsigned char ch, unsigned int val)
+{
+    unsigned char z = ZONE(mpe_master[ch]);
+    unsigned char cents = val & 0x7F;
+
+    if (cents > 99) cents = 99;
+    zone_range[z] = (val & 0x3F80) | cents;
+    zone_scale[z] = ((long)((val >> 7) * 100 + cents) * DAC_Q4_PER_NOTE) / 100;
+    coalPut(&coal_pitch);
+}
+
+
+// Member bend range of a member channel's zone, RPN 0 format
+unsigned int mpeRangeRead(unsigned char ch)
+{
+    return zone_range[ZONE(mpe_master[ch])];
+}
+
+
+// Member channels of a zone, 0 if it is off
+unsigned char mpeMembers(unsigned char master)
+{
+    return zone_members[ZONE(master)];
+}
+
+
+// Pitch bend on a member channel, called from the MIDI RX interrupt
+RAM_FUNC(mpeBendRx)
+void mpeBendRx(unsigned char ch, int bend)
+{
+    mpe_bend[ch] = bend;
+    if (ch == mpe_out_ch) coalPut(&coal_pitch);
+}
+
+
+// Channel pressure on any channel of the unit, called from the MIDI RX interrupt
+RAM_FUNC(mpePressureRx)
+void mpePressureRx(unsigned char ch, unsigned char val)
+{
+    mpe_pressure[ch] = val;
+    if (ch == mpe_out_ch) coalPut(&coal_pressure);
+}
+
+
+// A note on ch now owns the output, its pressure applies from here on
+void mpeOwner(unsigned char ch)
+{
+    mpe_out_ch = ch;
+    #if ENV_OUT == 1
+        envPressure(mpe_pressure[ch]);
+    #endif
+}
+
+
+// Per-note bend of the output owner in 1/16 DAC LSB, 0 outside a member channel
+long mpeBendQ4(void)
+{
+    unsigned char ch = mpe_out_ch;
+
+    if (!mpeMember(ch)) return 0;
+    return ((long)mpe_bend[ch] * zone_scale[ZONE(mpe_master[ch])]) >> 13;
+}
@@ -0,0 +1,59 @@
+/*
+ * mpe.h
+ *
+ * MIDI Polyphonic Expression: zones and per-channel bend and pressure
+ *
+ */
+
+#ifndef MPE_H_
+#define MPE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define MPE_NUM_CH          16
+#define MPE_NO_ZONE         0xFF    // mpe_master of a channel outside both zones
+#define MPE_LOWER_MASTER    0       // MIDI channel 1
+#define MPE_UPPER_MASTER    15      // MIDI channel 16
+#define MPE_MAX_MEMBERS     15
+#define MPE_DEF_RANGE       48      // member channel bend range in semitones after an MCM
+
+// 1 if a channel is a member channel of a zone, its bend and pressure are per note
+#define mpeMember(ch)       (mpe_master[ch] != MPE_NO_ZONE && mpe_master[ch] != (ch))
+
+// 1 if a channel is a zone master
+#define mpeMaster(ch)       (mpe_master[ch] == (ch))
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned char mpe_master[MPE_NUM_CH];    // master channel of each channel's zone, MPE_NO_ZONE outside
+extern int mpe_bend[MPE_NUM_CH];                // last bend on each member channel, -8192 to 8191
+extern unsigned char mpe_pressure[MPE_NUM_CH];  // last channel pressure on each channel
+extern unsigned char mpe_out_ch;                // channel of the note that owns the output
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void mpeConfig(unsigned char master, unsigned char members);    // MPE configuration message (RPN 6) on a master channel
+void mpeRange(unsigned char ch, unsigned int val);      // Member bend range (RPN 0) received on a member channel
+unsigned int mpeRangeRead(unsigned char ch);            // Member bend range of a member channel's zone, RPN 0 format
+unsigned char mpeMembers(unsigned char master);         // Member channels of a zone, 0 if it is off
+void mpeBendRx(unsigned char ch, int bend);             // Pitch bend on a member channel
+void mpePressureRx(unsigned char ch, unsigned char val);    // Channel pressure on any channel of the unit
+void mpeOwner(unsigned char ch);                        // A note on ch now owns the output
+long mpeBendQ4(void);                                   // Per-note bend of the output owner in 1/16 DAC LSB
+
+
+#endif /* MPE_H_ */
@@ -0,0 +1,269 @@
+/*
+ * mts.c
+ *
+ * Note on looks a note's pitch up in pitch_lut, which holds the MTS tuning
+ * already converted to 1/16 DAC LSB by interpolating dac_lut between the
+ * target semitone and the next. The whole table is only built at boot and
+ * after a bulk dump. A single note tuning change writes its note to FRAM and
+ * converts just that entry, so real-time retuning costs one interpolation.
+ *
+ * A bulk dump is unpacked into the FRAM stage while it arrives, like a block
+ * restore. Once the checksum matches it is committed as FRAM_BLOCK_TUNING by
+ * the main loop, so a bad or interrupted dump never touches the active
+ * tuning.
+ *
+ */
+
+#include <mts.h>
+#include <mcu_vco.h>
+#include <midi.h>
+#include <midi_luts.h>
+#include <fram_store.h>
+#include <sysex.h>
+#include <midi_cc.h>
+#include <stddef.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+// receive states
+#define MTS_IDLE        0       // not ours or ignored until the next F0
+#define MTS_DEV         1
+#define MTS_SUB1        2
+#define MTS_SUB2        3
+#define MTS_PROGRAM     4
+#define MTS_NAME        5       // bulk dump
+#define MTS_BULK        6
+#define MTS_CHECKSUM    7
+#define MTS_COUNT       8       // single note tuning change
+#define MTS_CHANGE      9
+#define MTS_END         10      // complete, waiting for F7
+
+#define MTS_LAST_LUT    120     // highest note in dac_lut
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+FRAM_PERSISTENT(fram_mts)
+struct mts_table fram_mts = { 0 };      // reset to 12-TET on the first boot
+
+unsigned int pitch_lut[MTS_NUM_NOTES];
+
+static unsigned char rx_state = MTS_IDLE;
+static unsigned char rx_realtime;
+static unsigned char rx_sub;
+static unsigned char rx_sum;            // XOR of the bulk dump bytes
+static unsigned char rx_ok;             // bulk dump checksum matched
+static unsigned int  rx_pos;            // byte within the name or the note data
+static unsigned char rx_count;          // note changes left
+static unsigned char rx_data[4];        // current note group
+
+extern unsigned char midi_channel;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Pitch of a semitone plus a 14-bit fraction in 1/16 DAC LSB
+static unsigned int mtsQ4(unsigned char semi, unsigned int frac)
+{
+    unsigned int lo, hi;
+
+    if (semi >= MTS_LAST_LUT) return conv_midi_to_dac(MTS_LAST_LUT) << 4;
+
+    lo = conv_midi_to_dac(semi);
+    hi = conv_midi_to_dac(semi + 1);
+    return (lo << 4) + (unsigned int)((((unsigned long)(hi - lo) << 4) * frac) >> 14);
+}
+
+
+// Convert one note of the FRAM tuning into the pitch table
+static void mtsNote(unsigned char note)
+{
+    unsigned short state;
+
+    // single note changes arrive in the MIDI RX interrupt
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    pitch_lut[note] = mtsQ4(fram_mts.semi[note], fram_mts.frac[note]);
+    __set_interrupt_state(state);
+}
+
+
+// Rebuild the pitch table from the FRAM tuning, 12-TET if there is none
+void mtsBuild(void)
+{
+    unsigned char n;
+
+    if (fram_mts.version != MTS_VERSION)
+    {
+        for (n = 0; n < MTS_NUM_NOTES; n++)
+        {
+            fram_mts.semi[n] = n;
+            fram_mts.frac[n] = 0;
+        }
+        fram_mts.version = MTS_VERSION;     // written last, a reset before this starts over
+    }
+
+    for (n = 0; n < MTS_NUM_NOTES; n++) mtsNote(n);
+}
+
+
+// 1 if a note is tuned to 12-TET, the retune targets only hold for these
+unsigned char mtsEqual(unsigned char note)
+{
+    return fram_mts.semi[note] == note && fram_mts.frac[note] == 0;
+}
+
+
+// Write a little endian word into the stage
+static void mtsStageWord(unsigned int pos, unsigned int word)
+{
+    fram_stage[pos]     = word & 0xFF;
+    fram_stage[pos + 1] = word >> 8;
+}
+
+
+// Stage one note of a bulk dump
+static void mtsStageNote(unsigned char note)
+{
+    unsigned char semi = rx_data[0];
+    unsigned int  frac = ((unsigned int)rx_data[1] << 7) | rx_data[2];
+
+    // 7F 7F 7F keeps the note as it is
+    if (semi == 0x7F && frac == 0x3FFF)
+    {
+        semi = fram_mts.semi[note];
+        frac = fram_mts.frac[note];
+    }
+    fram_stage[offsetof(struct mts_table, semi) + note] = semi;
+    mtsStageWord(offsetof(struct mts_table, frac) + 2 * note, frac);
+}
+
+
+// Apply one single note tuning change
+static void mtsChange(void)
+{
+    unsigned char note = rx_data[0];
+
+    if (rx_data[1] == 0x7F && rx_data[2] == 0x7F && rx_data[3] == 0x7F) return;
+
+    fram_mts.semi[note] = rx_data[1];
+    fram_mts.frac[note] = ((unsigned int)rx_data[2] << 7) | rx_data[3];
+    mtsNote(note);
+    coalPut(&coal_pitch);              // re-sound a held note at its new pitch
+}
+
+
+// Start of a universal SysEx, 7E non-real-time or 7F real-time
+void mtsStart(unsigned char universal_id)
+{
+    rx_realtime = (universal_id == MIDI_SYSEX_REALTIME);
+    rx_sub      = 0;
+    rx_sum      = universal_id;
+    rx_state    = MTS_DEV;
+}
+
+
+// Feed one byte of a universal SysEx, after the 7E or 7F
+void mtsRx(unsigned char byte)
+{
+    rx_sum ^= byte;
+
+    switch (rx_state)
+    {
+        case MTS_DEV:
+            rx_state = (byte == SYSEX_DEV_ALL || byte == midi_channel) ? MTS_SUB1 : MTS_IDLE;
+            break;
+
+        case MTS_SUB1:
+            rx_state = (byte == MTS_SUB_ID) ? MTS_SUB2 : MTS_IDLE;
+            break;
+
+        case MTS_SUB2:
+            rx_sub   = byte;
+            rx_state = MTS_IDLE;
+            if (rx_realtime && byte == MTS_NOTE_CHANGE)
+            {
+                rx_state = MTS_PROGRAM;
+            }
+            else if (!rx_realtime && byte == MTS_BULK_DUMP)
+            {
+                // stage still in use by the previous restore
+                if (f_sysex_commit) sysex_errors++;
+                else rx_state = MTS_PROGRAM;
+            }
+            break;
+
+        case MTS_PROGRAM:
+            rx_pos   = 0;
+            rx_state = (rx_sub == MTS_BULK_DUMP) ? MTS_NAME : MTS_COUNT;
+            break;
+
+        case MTS_NAME:
+            if (++rx_pos == SIZE_MTS_NAME)
+            {
+                rx_pos   = 0;
+                rx_state = MTS_BULK;
+            }
+            break;
+
+        case MTS_BULK:
+            rx_data[rx_pos % 3] = byte;
+            if (++rx_pos % 3 == 0) mtsStageNote(rx_pos / 3 - 1);
+            if (rx_pos == 3 * MTS_NUM_NOTES) rx_state = MTS_CHECKSUM;
+            break;
+
+        case MTS_CHECKSUM:
+            rx_ok    = ((rx_sum & 0x7F) == 0);  // the sum so far XOR the checksum
+            rx_state = MTS_END;
+            break;
+
+        case MTS_COUNT:
+            rx_count = byte;
+            rx_state = rx_count ? MTS_CHANGE : MTS_END;
+            break;
+
+        case MTS_CHANGE:
+            rx_data[rx_pos++] = byte;
+            if (rx_pos == 4)
+            {
+                mtsChange();
+                rx_pos = 0;
+                if (--rx_count == 0) rx_state = MTS_END;
+            }
+            break;
+
+        case MTS_END:                   // too long, drop it
+            if (rx_sub == MTS_BULK_DUMP) sysex_errors++;
+            rx_state = MTS_IDLE;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+// F7 of a universal SysEx, commits a complete bulk dump
+void mtsEnd(void)
+{
+    if (rx_sub == MTS_BULK_DUMP && rx_state != MTS_IDLE && !rx_realtime)
+    {
+        if (rx_state == MTS_END && rx_ok)
+        {
+            mtsStageWord(offsetof(struct mts_table, version), MTS_VERSION);
+            framStage(FRAM_BLOCK_TUNING, sizeof(fram_mts));
+            f_sysex_commit = 1;
+        }
+        else sysex_errors++;
+    }
+    rx_state = MTS_IDLE;
+}
@@ -0,0 +1,70 @@
+/*
+ * mts.h
+ *
+ * MIDI Tuning Standard: tuning kept in FRAM and the active pitch table
+ *
+ * Messages (universal SysEx, tt = tuning program, ignored, one table is kept):
+ *   F0 7E dd 08 01 tt <16 name> [xx yy zz]x128 cs F7   bulk tuning dump
+ *   F0 7F dd 08 02 tt ll [kk xx yy zz]xll F7          single note tuning change
+ * xx is the semitone the note sounds at and yy zz the 14-bit fraction of a
+ * semitone above it, 7F 7F 7F leaves the note unchanged. cs is the XOR of
+ * every byte from 7E up to the last data byte. dd is the unit's MIDI channel
+ * or 7F for all units.
+ *
+ */
+
+#ifndef MTS_H_
+#define MTS_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define MTS_VERSION         1       // struct mts_table layout, anything else resets to 12-TET
+#define MTS_NUM_NOTES       128
+#define SIZE_MTS_NAME       16
+
+#define MTS_SUB_ID          0x08    // MIDI tuning standard
+#define MTS_BULK_DUMP       0x01    // non-real-time
+#define MTS_NOTE_CHANGE     0x02    // real-time
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// tuning, as received
+struct mts_table {
+    unsigned int  version;                  // MTS_VERSION
+    unsigned int  frac[MTS_NUM_NOTES];      // 14-bit fraction of a semitone above semi
+    unsigned char semi[MTS_NUM_NOTES];      // semitone each note sounds at
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern struct mts_table fram_mts;
+extern unsigned int pitch_lut[MTS_NUM_NOTES];   // active pitch of every note in 1/16 DAC LSB
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void mtsBuild(void);                                    // Rebuild the pitch table from the FRAM tuning
+unsigned char mtsEqual(unsigned char note);             // 1 if a note is tuned to 12-TET
+void mtsStart(unsigned char universal_id);              // Start of a universal SysEx, 7E or 7F
+void mtsRx(unsigned char byte);                         // Feed one byte of a universal SysEx
+void mtsEnd(void);                                      // F7 of a universal SysEx
+
+
+#endif /* MTS_H_ */
@@ -0,0 +1,82 @@
+/*
+ * pitch.c
+ *
+ * Pitch is summed in 1/16 DAC LSB so a bend or fine tune smaller than one DAC
+ * step still adds up before the final rounding. A note's pitch is its entry in
+ * the MTS pitch table (dac_lut unless a tuning was loaded) plus the coarse and fine tune of the active preset, the FLL trim and
+ * the 14-bit pitch bend scaled by the preset bend range, plus the MPE per-note
+ * bend of the channel that owns the output. The range and tune
+ * are read from the preset on every update, so an RPN change applies to the
+ * next bend without rebuilding anything.
+ *
+ */
+
+#include <pitch.h>
+#include <mcu_vco.h>
+#include <mts.h>
+#include <retune.h>
+#include <preset.h>
+#include <trace.h>
+#include <mpe.h>
+
+#if PITCH_FINE_DAC == 1
+    extern unsigned int dac_fine;       // owned by main.c
+#endif
+
+#if FLIGHT_TRACE == 1
+    static unsigned int trace_dac = 0;  // pitch DAC of the last TRACE_DAC record
+#endif
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Pitch of a note in 1/16 DAC LSB, bend is -8192 to 8191
+RAM_FUNC(pitchQ4)
+unsigned int pitchQ4(unsigned char note, int bend)
+{
+    long q4 = pitch_lut[note & 0x7F];
+
+    // full bend in 1/16 DAC LSB, at most 127.99 semitones so it fits 17 bits
+    long bend_scale = ((long)(preset->bend_range * 100 + preset->bend_cents) * DAC_Q4_PER_NOTE) / 100;
+
+    q4 += fllTrim(note);
+    q4 += (long)preset->coarse_tune * DAC_Q4_PER_NOTE;
+    q4 += ((long)preset->fine_tune * DAC_Q4_PER_NOTE) >> 13;
+    q4 += ((long)bend * bend_scale) >> 13;
+    q4 += mpeBendQ4();
+
+    if (q4 < 0) q4 = 0;
+    if (q4 > PITCH_Q4_MAX) q4 = PITCH_Q4_MAX;
+    return (unsigned int)q4;
+}
+
+
+// Set the pitch DAC, with the rest on the fine DAC once its ratio is measured, else rounded to the nearest step
+RAM_FUNC(pitchOut)
+void pitchOut(unsigned int q4)
+{
+    unsigned int dac = (q4 + 8) >> 4;
+
+    #if PITCH_FINE_DAC == 1
+        if (dac_fine)
+        {
+            unsigned long fine = ((unsigned long)(q4 & 0x0F) * dac_fine) >> 4;
+
+            dac = q4 >> 4;
+            setPitchDAC(dac, (fine > 4095) ? 4095 : (unsigned int)fine);
+        }
+        else
+    #endif
+    SET_DAC0(dac);
+
+    // bends and the FLL trim write the DAC every tick, trace only real moves
+    #if FLIGHT_TRACE == 1
+        if ((int)(dac - trace_dac) >= TRACE_DAC_STEP || (int)(trace_dac - dac) >= TRACE_DAC_STEP)
+        {
+            trace_dac = dac;
+            TRACE_EVT(TRACE_DAC, 0, dac);
+        }
+    #endif
+}
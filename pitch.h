@@ -0,0 +1,31 @@
+/*
+ * pitch.h
+ *
+ * Integer pitch path from a MIDI note to the pitch DAC
+ *
+ */
+
+#ifndef PITCH_H_
+#define PITCH_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define PITCH_Q4_MAX      0xFFF0    // full scale of the 12-bit pitch DAC in 1/16 LSB
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+unsigned int pitchQ4(unsigned char note, int bend);     // Pitch of a note in 1/16 DAC LSB with tune, bend and MPE bend
+void pitchOut(unsigned int q4);                         // Set the pitch DAC
+
+
+#endif /* PITCH_H_ */
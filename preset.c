@@ -0,0 +1,107 @@
+/*
+ * preset.c
+ *
+ * Presets are fixed size records in FRAM. The note path reads the active one
+ * through the preset pointer, so a Program Change only moves the pointer and
+ * costs the same no matter how big a record gets.
+ *
+ * Edits go to a RAM copy which the pointer moves to while it is dirty. The
+ * main loop writes it back to its FRAM slot when no note is held and moves
+ * the pointer back, so an edit never holds up a note.
+ *
+ */
+
+#include <preset.h>
+#include <mcu_vco.h>
+#include <fram_store.h>
+#include <string.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+// used for empty slots
+static const struct preset preset_default = {
+    PRESET_VERSION, PRESET_CH_UNIT, MAX_PITCH_BEND, PRIORITY_LAST, 0, 0, 0,
+    ENV_DEF_ATTACK, ENV_DEF_DECAY, ENV_DEF_SUSTAIN, ENV_DEF_RELEASE, ENV_DEF_VEL_DEPTH, ENV_MODE_RETRIGGER, 0 };
+
+FRAM_PERSISTENT(preset_bank)
+struct preset preset_bank[NUM_PRESETS] = { { 0 } };
+
+const struct preset *preset = &preset_default;
+
+static struct preset preset_edit;           // RAM copy while being edited
+static unsigned char edit_slot = 0;
+static unsigned char edit_dirty = 0;
+
+extern unsigned char midi_channel;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Switch the active preset, program numbers wrap at NUM_PRESETS
+void presetSelect(unsigned char program)
+{
+    unsigned short state;
+
+    program &= NUM_PRESETS - 1;
+
+    // records saved before the envelope existed get its defaults
+    if (preset_bank[program].version == PRESET_VERSION_1)
+    {
+        preset_bank[program].env_attack    = ENV_DEF_ATTACK;
+        preset_bank[program].env_decay     = ENV_DEF_DECAY;
+        preset_bank[program].env_sustain   = ENV_DEF_SUSTAIN;
+        preset_bank[program].env_release   = ENV_DEF_RELEASE;
+        preset_bank[program].env_vel_depth = ENV_DEF_VEL_DEPTH;
+        preset_bank[program].env_mode      = ENV_MODE_RETRIGGER;
+        preset_bank[program].version       = PRESET_VERSION;
+    }
+
+    // a pending edit belongs to the old slot, 16 bytes are cheap to write now.
+    // An edit from the MIDI ISR must land in the old slot or the new one, not
+    // between the flush and the swap
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    presetFlush();
+    preset = (preset_bank[program].version == PRESET_VERSION) ? &preset_bank[program] : &preset_default;
+    edit_slot = program;
+    __set_interrupt_state(state);
+    fram_cfg.program = program;
+
+    midi_channel = (preset->channel == PRESET_CH_UNIT) ? fram_cfg.midi_channel : (preset->channel & 0x0F);
+}
+
+
+// Writable copy of the active preset, written back by presetFlush
+struct preset *presetEdit(void)
+{
+    if (!edit_dirty)
+    {
+        preset_edit = *preset;
+        preset = &preset_edit;
+        edit_dirty = 1;
+    }
+    return &preset_edit;
+}
+
+
+// Write an edited preset back to FRAM
+void presetFlush(void)
+{
+    unsigned short state;
+
+    if (!edit_dirty) return;
+
+    // an edit from the MIDI ISR must not land between the copy and the pointer swap
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    memcpy(&preset_bank[edit_slot], &preset_edit, sizeof(preset_edit));
+    preset = &preset_bank[edit_slot];
+    edit_dirty = 0;
+    __set_interrupt_state(state);
+}
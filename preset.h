@@ -0,0 +1,85 @@
+/*
+ * preset.h
+ *
+ * Preset bank in FRAM, recalled with MIDI Program Change
+ *
+ */
+
+#ifndef PRESET_H_
+#define PRESET_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define NUM_PRESETS         32
+#define PRESET_VERSION      2       // records with another version are treated as empty
+#define PRESET_VERSION_1    1       // before the envelope fields, upgraded when selected
+
+// note priority
+#define PRIORITY_LAST       0
+#define PRIORITY_LOW        1
+#define PRIORITY_HIGH       2
+
+#define PRESET_CH_UNIT      0xFF    // receive on the unit channel from the configuration
+
+// envelope trigger
+#define ENV_MODE_RETRIGGER  0       // every new note restarts the attack
+#define ENV_MODE_LEGATO     1       // notes played while another is held keep the envelope going
+
+// envelope defaults
+#define ENV_DEF_ATTACK      20      // ~4 ms
+#define ENV_DEF_DECAY       50      // ~38 ms
+#define ENV_DEF_SUSTAIN     100
+#define ENV_DEF_RELEASE     50
+#define ENV_DEF_VEL_DEPTH   64
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// fixed size preset record, 16 bytes
+struct preset {
+    unsigned char version;          // PRESET_VERSION
+    unsigned char channel;          // MIDI channel 0-15 or PRESET_CH_UNIT
+    unsigned char bend_range;       // pitch bend range in semitones
+    unsigned char priority;         // PRIORITY_*
+    unsigned char bend_cents;       // cents added to bend_range, RPN 0 LSB
+    signed char coarse_tune;        // semitones -64 to 63, RPN 2
+    int fine_tune;                  // -8192 to 8191 for -100 to +100 cents, RPN 1
+    unsigned char env_attack;       // envelope times 0-127, 1 ms to 10 s time constant
+    unsigned char env_decay;
+    unsigned char env_sustain;      // envelope sustain level 0-127
+    unsigned char env_release;
+    unsigned char env_vel_depth;    // 0 = velocity ignored, 127 = velocity 0 is silent
+    unsigned char env_mode;         // ENV_MODE_*
+    unsigned int cv_scale;          // pitch classes the CV input snaps to, bit 0 = C, 0 = all 12
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern struct preset preset_bank[NUM_PRESETS];
+extern const struct preset *preset;     // active preset, read directly on the note path
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void presetSelect(unsigned char program);               // Switch the active preset
+struct preset *presetEdit(void);                        // Writable copy of the active preset
+void presetFlush(void);                                 // Write an edited preset back to FRAM
+
+
+#endif /* PRESET_H_ */
@@ -0,0 +1,124 @@
+/*
+ * prof.c
+ *
+ * Each slot keeps the sample count, the total and the worst case of a code
+ * path in CPU cycles. 'p' on the debug terminal prints them with the code
+ * layout of the build and starts over, so the same MIDI input played into a
+ * RAM_HOT_PATH build and a FRAM build compares both layouts cycle for cycle.
+ *
+ * Cycles are counted between the two TB3R reads only. Interrupt entry and
+ * exit are left out, and an interrupt taken inside the note-on path is
+ * counted with it, so its maximum is only an upper bound.
+ *
+ * prof_block holds every other interrupt up to where it lets MIDI RX in again.
+ * Its maximum plus the RX maximum is the longest a received byte can wait, and
+ * the report checks it against one MIDI byte time together with the UART error
+ * counts.
+ *
+ */
+
+#include <prof.h>
+#include <mcu_vco.h>
+#include <sched.h>
+#include <midi_io.h>
+
+#if CYCLE_PROFILE == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+struct prof_slot prof_rx;
+struct prof_slot prof_note;
+struct prof_slot prof_block;
+struct prof_slot prof_sched;
+volatile unsigned char f_prof = 0;
+
+// state owned by main.c
+extern char debug_msg[SIZE_MESSAGE];
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Add one sample
+void profRec(struct prof_slot *slot, unsigned int cycles)
+{
+    if (slot->count == PROF_MAX_COUNT) return;
+    slot->count++;
+    slot->total += cycles;
+    if (cycles > slot->max) slot->max = cycles;
+}
+
+
+// Print a line once the previous one is out
+static void profPrint(void)
+{
+    UCA1IE |= UCTXIE;
+    while (UCA1IE & UCTXIE);
+}
+
+
+// Print one slot and clear it, returns its maximum
+static unsigned int profSlot(const char *name, struct prof_slot *slot)
+{
+    struct prof_slot s;
+    unsigned short state;
+
+    // most slots are written by interrupts
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    s = *slot;
+    slot->count = 0;
+    slot->total = 0;
+    slot->max   = 0;
+    __set_interrupt_state(state);
+
+    sprintf(debug_msg, "P %s N %d AVG %d MAX %d\r\n", name, s.count,
+            s.count ? (int)(s.total / s.count) : 0, s.max);
+    profPrint();
+    return s.max;
+}
+
+
+// Print and clear every slot on the debug terminal
+void profReport(void)
+{
+    unsigned int bound;
+    unsigned char u;
+
+    f_prof = 0;
+
+    #if RAM_HOT_PATH == 1
+        sprintf(debug_msg, "P HOT PATH RAM\r\n");
+    #else
+        sprintf(debug_msg, "P HOT PATH FRAM %d WS\r\n", (int)(CLK_NWAITS >> 4));
+    #endif
+    profPrint();
+
+    // worst case from UCRXIFG to reading UCA0RXBUF, must fit one byte time
+    bound  = profSlot("RX", &prof_rx);
+    bound += profSlot("BLOCK", &prof_block);
+    sprintf(debug_msg, "P RX BOUND %d/%d %s\r\n", bound, PROF_BYTE_CNT, bound < PROF_BYTE_CNT ? "OK" : "OVER");
+    profPrint();
+
+    profSlot("NOTE", &prof_note);
+
+    #if NOTE_SCHED == 1
+        profSlot("JITTER", &prof_sched);
+        sprintf(debug_msg, "P SCHED LATE %d\r\n", sched_late);
+        profPrint();
+    #endif
+
+    for (u = 0; u < 2; u++)
+    {
+        sprintf(debug_msg, "P UCA%d OE %d FE %d\r\n", u, uart_errors[u].overruns, uart_errors[u].framing);
+        profPrint();
+    }
+}
+
+
+#endif
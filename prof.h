@@ -0,0 +1,67 @@
+/*
+ * prof.h
+ *
+ * CPU cycle profile of the MIDI RX interrupt and the note-on path on TB3R
+ *
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define PROF_MAX_COUNT    0x7FFF        // samples kept, the average stays exact until then
+#define PROF_BYTE_CNT     ((unsigned int)(MCLK_FREQ / 3125))    // cycles per MIDI byte, 10 bits at 31250 baud
+
+// TB3R runs free on SMCLK = MCLK, so a difference of two reads is CPU cycles
+#if CYCLE_PROFILE == 1
+    #define PROF_START(slot)    ((slot).start = TB3R)
+    #define PROF_END(slot)      profRec(&(slot), TB3R - (slot).start)
+#else
+    #define PROF_START(slot)    do { } while (0)
+    #define PROF_END(slot)      do { } while (0)
+#endif
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// cycles of one code path
+struct prof_slot {
+    unsigned int start;         // TB3R at PROF_START
+    unsigned int count;         // samples, stops at PROF_MAX_COUNT
+    unsigned int max;
+    unsigned long total;
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern struct prof_slot prof_rx;                // USCI_A0_ISR receiving a byte, parser included
+extern struct prof_slot prof_note;              // note-on, priority to the pitch DAC
+extern struct prof_slot prof_block;             // any other interrupt while it keeps GIE off
+extern struct prof_slot prof_sched;             // NOTE_SCHED events, TB3 counts from their time to the compare interrupt
+extern volatile unsigned char f_prof;           // report requested from the debug terminal
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void profRec(struct prof_slot *slot, unsigned int cycles);      // Add one sample
+void profReport(void);                                  // Print and clear every slot on the debug terminal
+
+
+#endif /* PROF_H_ */
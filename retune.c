@@ -0,0 +1,288 @@
+/*
+ * retune.c
+ *
+ * The VCO drifts with temperature, so while playing the period of the output
+ * is measured with the same TB0/TB1 counter the start-up tune uses, whenever
+ * the pitch holds still long enough:
+ *   - no note held: the DAC sits at note 0, which is the start-up tune target
+ *   - a note held without bend: the count is compared with that note's period,
+ *     only for notes the MTS tuning leaves at 12-TET and with the preset
+ *     coarse and fine tune at 0
+ *
+ * A measurement only counts if the output did not change while it ran. The
+ * EXP FREQ offset moves one LSB at a time after several measurements agree,
+ * no more often than RETUNE_HOLDOFF measurements, and only while no note is
+ * held, so a sounding note is never bent. HARD SYNC mutes the idle output and
+ * would stop the counter, so it is released for the idle measurement, note 0
+ * is below the audio range, and set again once it ends unless a note has
+ * taken the output meanwhile. Idle measurements are RETUNE_IDLE_GAP ticks
+ * apart, so the idle output stays muted most of the time. A measurement
+ * without a result in RETUNE_TIMEOUT ticks is dropped, the output was muted
+ * under it.
+ *
+ * With PITCH_FLL the held note window instead closes a slow loop around the
+ * VCO: the count over several periods is compared with conv_midi_to_freq for
+ * that note and an integrator trims the pitch DAC. The trim is kept per note,
+ * so a note that was locked once comes back already corrected. The update is
+ * a couple of 32-bit divisions per 62.5 ms gate, done in the main loop.
+ *
+ */
+
+#include <mcu_vco.h>
+#include <retune.h>
+#include <midi_luts.h>
+#include <fram_store.h>
+#include <pitch.h>
+#include <trace.h>
+#include <mts.h>
+#include <mpe.h>
+#include <preset.h>
+#include <timer_wheel.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned char f_bg_tune = 0;
+int retune_pending = 0;
+unsigned int retune_steps = 0;
+unsigned int meas_periods = 1;
+
+#if PITCH_FLL == 1
+    unsigned char fll_lock = 0;
+    int fll_err = 0;
+
+    static int fll_trim[MTS_NUM_NOTES]; // per note correction in 1/16 DAC LSB
+    static unsigned char fll_in_lock = 0;   // consecutive measurements within FLL_LOCK_ERR
+#endif
+
+static unsigned char win_type = 0;      // RETUNE_WIN_* of the running measurement
+static unsigned int  win_dac  = 0;      // SAC0DAT when the measurement started
+static unsigned char win_note = 0;      // note being measured
+static signed char   votes    = 0;      // consecutive agreeing measurements, sign = direction
+static unsigned char holdoff  = 0;      // measurements left before the next step
+static unsigned char unmuted  = 0;      // HARD SYNC released for the idle measurement
+static unsigned int  meas_start;        // ctrl_ticks when the measurement started
+static struct sw_timer idle_timer;      // gap after an idle measurement
+static volatile unsigned char idle_gap = 0;     // no idle measurement until idle_timer fires
+
+// state owned by main.c
+extern struct note midi_notes[SIZE_NOTE_STACK];
+extern unsigned char ptr_note;
+extern int midi_pitch_bend_val;
+extern unsigned int dac_expoff;
+extern unsigned int t_meas;
+extern unsigned char num_ignored;
+extern unsigned char soundingNote(void);
+extern volatile unsigned int ctrl_ticks;
+
+#if DEBUG == 1
+    extern char debug_msg[SIZE_MESSAGE];
+#endif
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Expected tune count for one period of a note, scaled down from note 0
+unsigned int retuneTargetCount(unsigned char note)
+{
+    // 2^(-n/12) for one octave in Q15
+    static const unsigned int semitone_q15[12] = {
+        32768, 30929, 29193, 27554, 26008, 24548,
+        23170, 21870, 20643, 19484, 18390, 17358 };
+
+    unsigned long cnt = ((unsigned long)CNT_AT_0V * semitone_q15[note % 12]) >> 15;
+    return (unsigned int)(cnt >> (note / 12));
+}
+
+
+// Error of a count over periods periods of a note in 0.1 cent against conv_midi_to_freq, + is sharp
+int retuneCents(unsigned char note, unsigned int periods, unsigned int count)
+{
+    // expected ticks per period in 1/16 tick from the reference frequency
+    unsigned long exp_q4  = (((unsigned long)TUNE_CLK_FREQ << 12) / conv_midi_to_freq(note)) * periods;
+    unsigned long meas_q4 = (unsigned long)count << 4;
+    long diff = (long)exp_q4 - (long)meas_q4;
+
+    // ln(1+x) ~ x near lock, clamp to about a semitone to keep it in 32 bits
+    if (diff >  (long)(meas_q4 >> 4)) diff =  (long)(meas_q4 >> 4);
+    if (diff < -(long)(meas_q4 >> 4)) diff = -(long)(meas_q4 >> 4);
+    return (int)((diff * 17312) / (long)meas_q4);
+}
+
+
+#if PITCH_FLL == 1
+// FLL correction of a note in 1/16 DAC LSB, added on the pitch path
+int fllTrim(unsigned char note)
+{
+    return fll_trim[note];
+}
+
+
+// Integrate one measurement of a held note into its trim
+static void fllUpdate(unsigned char note)
+{
+    unsigned char was_locked = fll_lock;
+
+    fll_err = retuneCents(note, meas_periods, t_meas);
+    fll_trim[note] -= (int)(((long)fll_err * FLL_GAIN_NUM) >> FLL_GAIN_SHIFT);
+    if (fll_trim[note] >  FLL_TRIM_MAX) fll_trim[note] =  FLL_TRIM_MAX;
+    if (fll_trim[note] < -FLL_TRIM_MAX) fll_trim[note] = -FLL_TRIM_MAX;
+
+    // correct the sounding note, only measured while there is no bend
+    pitchOut(pitchQ4(note, 0));
+
+    if (fll_err < FLL_LOCK_ERR && fll_err > -FLL_LOCK_ERR)
+    {
+        if (fll_in_lock < FLL_LOCK_CNT) fll_in_lock++;
+    }
+    else fll_in_lock = 0;
+    fll_lock = (fll_in_lock == FLL_LOCK_CNT);
+    if (fll_lock != was_locked) TRACE_EVT(TRACE_TUNE, TRACE_TUNE_FLL, fll_err);
+
+    #if DEBUG == 1
+        if (fll_lock != was_locked)
+        {
+            sprintf(debug_msg, "FLL N = %d %s %d\r\n", note, fll_lock ? "LOCK" : "UNLOCK", fll_err);
+            UCA1IE |= UCTXIE;
+        }
+    #endif
+}
+#endif
+
+
+// Decide which window the current output is in, 0 if it is moving or off 12-TET
+static unsigned char retuneWindow(void)
+{
+    if (!midi_notes[0].on) return (SAC0DAT == 0) ? RETUNE_WIN_IDLE : 0;     // not during a release
+    if (ptr_note > 0 && midi_pitch_bend_val == 0 && mpeBendQ4() == 0 && mtsEqual(soundingNote())
+        && preset->coarse_tune == 0 && preset->fine_tune == 0) return RETUNE_WIN_HELD;
+    return 0;
+}
+
+
+// End of the idle gap, from the tick interrupt
+static void retuneIdleDue(void)
+{
+    idle_gap = 0;
+}
+
+
+// Mute again after the idle measurement, unless a note has the output now, and start the gap
+static void retuneMute(void)
+{
+    if (!unmuted) return;
+    unmuted = 0;
+    if (!midi_notes[0].on && SAC0DAT == 0) HARD_SYNC_ON;
+
+    idle_gap = 1;
+    timerArm(&idle_timer, RETUNE_IDLE_GAP, 0, retuneIdleDue);
+}
+
+
+// Stop a background measurement
+void retuneAbort(void)
+{
+    TB1CTL = 0;                         // clears TBIE and TBIFG, the ISR won't fire again
+    TB0CTL = 0;
+    num_ignored = 0;
+    f_bg_tune = 0;
+    retuneMute();
+}
+
+
+// Run one step of the background retune from the main loop
+void retuneService(void)
+{
+    unsigned char win = retuneWindow();
+
+    switch (f_bg_tune)
+    {
+        case 0:  // start a measurement if the pitch holds still
+            if (win == 0 || (win == RETUNE_WIN_IDLE && idle_gap)) break;
+            win_type = win;
+            win_dac  = SAC0DAT;
+            win_note = (win == RETUNE_WIN_IDLE) ? 0 : soundingNote();
+            meas_periods = 1;
+            #if PITCH_FLL == 1
+                // average over as many periods as fit the gate
+                if (win == RETUNE_WIN_HELD)
+                {
+                    meas_periods = FLL_GATE_CNT / retuneTargetCount(win_note);
+                    if (meas_periods == 0) meas_periods = 1;
+                }
+            #endif
+            if (win == RETUNE_WIN_IDLE)
+            {
+                HARD_SYNC_OFF;          // the counter needs edges, note 0 is sub-audio
+                unmuted = 1;
+            }
+            meas_start = ctrl_ticks;
+            f_bg_tune = 2;
+            initFreqCtr();
+            break;
+
+        case 2:  // wait to start measuring
+        case 4:  // wait until measurement complete
+            if (win != win_type || SAC0DAT != win_dac || ctrl_ticks - meas_start >= RETUNE_TIMEOUT) retuneAbort();
+            #if PITCH_FLL == 1
+                if (win != RETUNE_WIN_HELD) fll_in_lock = fll_lock = 0;
+            #endif
+            break;
+
+        case 8:  // check measurement
+        {
+            unsigned int target = retuneTargetCount(win_note);
+            unsigned int tol    = (unsigned int)(((unsigned long)target * CNT_AT_0V_TOL) / CNT_AT_0V) + 1;
+
+            f_bg_tune = 0;
+            retuneMute();
+            if (win != win_type || SAC0DAT != win_dac) break;
+
+            #if PITCH_FLL == 1
+                if (win == RETUNE_WIN_HELD)
+                {
+                    fllUpdate(win_note);
+                    break;
+                }
+            #endif
+
+            if (holdoff) holdoff--;
+
+            // long period means the VCO is flat, raise the EXP FREQ offset
+            if (t_meas > target + tol)      votes = (votes > 0) ? votes + 1 :  1;
+            else if (t_meas < target - tol) votes = (votes < 0) ? votes - 1 : -1;
+            else                            votes = 0;
+
+            if (votes >= RETUNE_VOTES || votes <= -RETUNE_VOTES)
+            {
+                retune_pending = (votes > 0) ? 1 : -1;
+                votes = 0;
+            }
+
+            // only move the offset while the output is muted
+            if (retune_pending && !holdoff && win == RETUNE_WIN_IDLE)
+            {
+                dac_expoff += retune_pending;
+                SET_DAC2(dac_expoff);
+                calSave(dac_expoff, fram_cal.dac_exp, fram_cal.dac_fine);
+                TRACE_EVT(TRACE_TUNE, TRACE_TUNE_BG, dac_expoff);
+                retune_steps++;
+                retune_pending = 0;
+                holdoff = RETUNE_HOLDOFF;
+                #if DEBUG == 1
+                    sprintf(debug_msg, "   BG EXP FREQ OFFSET = %d\r\n", dac_expoff);
+                    UCA1IE |= UCTXIE;
+                #endif
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * retune.h
+ *
+ * Background drift compensation for the EXP FREQ offset and the optional
+ * frequency locked loop on the pitch DAC
+ *
+ */
+
+#ifndef RETUNE_H_
+#define RETUNE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define RETUNE_VOTES      4     // consecutive measurements agreeing on a direction before a step
+#define RETUNE_HOLDOFF    8     // measurements between two steps of the EXP FREQ offset
+#define RETUNE_WIN_IDLE   1     // measuring note 0 with no note held
+#define RETUNE_WIN_HELD   2     // measuring a note held without pitch bend
+#define RETUNE_TIMEOUT    1000  // control ticks without a result before a measurement is dropped
+#define RETUNE_IDLE_GAP   3000  // control ticks between two idle measurements, the idle output stays muted meanwhile
+
+#define FLL_GATE_CNT      (TUNE_CLK_FREQ / 16)  // tune clock counts per FLL measurement (62.5 ms)
+#define FLL_GAIN_NUM      9     // integral gain, 1/16 DAC LSB per 0.1 cent of error =
+#define FLL_GAIN_SHIFT    5     //   (34 LSB per semitone)*16/1000 * 1/2 = 9/32
+#define FLL_TRIM_MAX      544   // correction limit in 1/16 DAC LSB (1 semitone)
+#define FLL_LOCK_ERR      50    // locked while the error stays within +/- 5 cents
+#define FLL_LOCK_CNT      3     // consecutive measurements within FLL_LOCK_ERR to report lock
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned char f_bg_tune;         // background measurement flag, advanced by Timer1_B1_ISR
+extern int retune_pending;              // EXP FREQ steps waiting for the next idle window
+extern unsigned int retune_steps;       // EXP FREQ steps applied since boot
+extern unsigned int meas_periods;       // periods per background measurement
+
+#if PITCH_FLL == 1
+    extern unsigned char fll_lock;      // 1 while the sounding note is locked
+    extern int fll_err;                 // last measured error in 0.1 cent, + is sharp
+#endif
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+unsigned int retuneTargetCount(unsigned char note);     // Expected tune count for one period of a note
+int retuneCents(unsigned char note, unsigned int periods, unsigned int count);  // Error of a count in 0.1 cent, + is sharp
+void retuneService(void);                               // Run one step of the background retune from the main loop
+void retuneAbort(void);                                 // Stop a background measurement
+
+#if PITCH_FLL == 1
+    int fllTrim(unsigned char note);                    // FLL correction of a note in 1/16 DAC LSB
+#else
+    #define fllTrim(note) 0
+#endif
+
+
+#endif /* RETUNE_H_ */
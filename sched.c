@@ -0,0 +1,224 @@
+/*
+ * sched.c
+ *
+ * How long a note took from the MIDI input to the pitch DAC used to depend on
+ * where the main loop was when it arrived. Now every received byte is stamped
+ * with TB3R in the RX interrupt, and the main loop only works out what a note
+ * does. The output itself is queued here and applied by the TB3 CCR3 compare
+ * interrupt SCHED_DELAY_CNT after the last byte of its message, so the
+ * latency is the same for every note and the jitter is the interrupt latency.
+ *
+ * Bends and CV notes are stamped when the main loop gets to them, so a note
+ * that arrived earlier but is queued after them is due first. Events are
+ * inserted in time order and only the first one needs the compare. An event
+ * the main loop got to too late to meet its time is applied at once and
+ * counted in sched_late. With CYCLE_PROFILE the lateness of every event
+ * applied by the compare goes into prof_sched, the jitter 'p' reports.
+ *
+ * The envelope attack and release go with the note events, so pitch, gate
+ * and envelope change at the same time. The envelope itself keeps running on
+ * the control tick.
+ *
+ */
+
+#include <sched.h>
+#include <mcu_vco.h>
+#include <pitch.h>
+#include <gate.h>
+#include <prof.h>
+#include <env.h>
+
+#if NOTE_SCHED == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned int sched_late = 0;
+
+static struct sched_evt queue[SIZE_SCHED];
+static volatile unsigned char q_head = 0;      // next free slot, free running
+static volatile unsigned char q_tail = 0;      // first event due
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Apply one event
+static void schedApply(const struct sched_evt *e)
+{
+    if (e->type == SCHED_NOTE)
+    {
+        pitchOut(e->pitch);
+        HARD_SYNC_OFF;
+        #if GATE_OUT == 1
+            gateOut(e->retrig);
+        #endif
+        #if ENV_OUT == 1
+            if (e->env != SCHED_ENV_NONE) envNoteOn(e->velocity, e->env == SCHED_ENV_LEGATO);
+        #endif
+    }
+    else
+    {
+        #if GATE_OUT == 1
+            gateOff();
+        #endif
+        #if ENV_OUT == 1
+            envNoteOff();
+        #else
+            SET_DAC0(0);
+            HARD_SYNC_ON;
+        #endif
+    }
+}
+
+
+// Arm the compare for the first event, applying every one that is already due
+static void schedArm(void)
+{
+    while (q_tail != q_head)
+    {
+        struct sched_evt *e = &queue[q_tail & SCHED_MASK];
+        int ahead = (int)(e->time - TB3R);
+
+        // further ahead than the delay only if TB3R wrapped since the message arrived
+        if (ahead > SCHED_MARGIN && ahead <= (int)SCHED_DELAY_CNT)
+        {
+            TB3CCR3  = e->time;
+            TB3CCTL3 = CCIE;            // also clears a stale CCIFG
+            return;
+        }
+        sched_late++;
+        schedApply(e);
+        q_tail++;
+    }
+    TB3CCTL3 = 0;
+}
+
+
+// Queue an event in time order, interrupts are off
+static void schedPut(unsigned char type, unsigned int pitch, unsigned char retrig, unsigned char env,
+                     unsigned char velocity, unsigned int time)
+{
+    struct sched_evt *e;
+    unsigned char i;
+
+    // full, the first goes out early rather than being lost
+    if ((unsigned char)(q_head - q_tail) == SIZE_SCHED)
+    {
+        sched_late++;
+        schedApply(&queue[q_tail & SCHED_MASK]);
+        q_tail++;
+    }
+
+    e = &queue[q_head & SCHED_MASK];
+    e->time     = time + SCHED_DELAY_CNT;
+    e->pitch    = pitch;
+    e->type     = type;
+    e->retrig   = retrig;
+    e->env      = env;
+    e->velocity = velocity;
+
+    // a note queued after a bend can be due before it, move the new event
+    // back past every later one, equal times stay in order. A pitch passed
+    // over was worked out before the new one, it takes the new pitch
+    i = q_head;
+    while (i != q_tail)
+    {
+        struct sched_evt *p = &queue[(unsigned char)(i - 1) & SCHED_MASK];
+        struct sched_evt t;
+
+        if ((int)(p->time - e->time) <= 0) break;
+        if (p->type == SCHED_NOTE && e->type == SCHED_NOTE) p->pitch = e->pitch;
+        t  = *p;
+        *p = *e;
+        *e = t;
+        e  = p;
+        i--;
+    }
+    q_head++;
+
+    // only the first event holds the compare, re-arm when it changed
+    if (i == q_tail) schedArm();
+}
+
+
+// Sound a pitch SCHED_DELAY_CNT after a message at time
+void schedNote(unsigned int pitch, unsigned char retrig, unsigned int time)
+{
+    unsigned short state;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    schedPut(SCHED_NOTE, pitch, retrig, SCHED_ENV_NONE, 0, time);
+    __set_interrupt_state(state);
+}
+
+
+// Sound a new note and start its envelope SCHED_DELAY_CNT after time
+void schedNoteOn(unsigned int pitch, unsigned char velocity, unsigned char legato, unsigned int time)
+{
+    unsigned short state;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    schedPut(SCHED_NOTE, pitch, 1, legato ? SCHED_ENV_LEGATO : SCHED_ENV_ON, velocity, time);
+    __set_interrupt_state(state);
+}
+
+
+// Gate down SCHED_DELAY_CNT after a message at time
+void schedOff(unsigned int time)
+{
+    unsigned short state;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    schedPut(SCHED_OFF, 0, 0, SCHED_ENV_NONE, 0, time);
+    __set_interrupt_state(state);
+}
+
+
+// Drop every queued event, before a mute
+void schedCancel(void)
+{
+    unsigned short state;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    TB3CCTL3 = 0;
+    q_tail = q_head;
+    __set_interrupt_state(state);
+}
+
+
+// 1 while events wait in the queue
+unsigned char schedPending(void)
+{
+    return q_tail != q_head;
+}
+
+
+// TB3 CCR3 compare, apply the event that is due
+void schedFire(void)
+{
+    // TB3CCR3 still holds the event time, the difference is the jitter
+    #if CYCLE_PROFILE == 1
+        profRec(&prof_sched, TB3R - TB3CCR3);
+    #endif
+
+    if (q_tail == q_head)
+    {
+        TB3CCTL3 = 0;
+        return;
+    }
+    schedApply(&queue[q_tail & SCHED_MASK]);
+    q_tail++;
+    schedArm();
+}
+
+
+#endif
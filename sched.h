@@ -0,0 +1,75 @@
+/*
+ * sched.h
+ *
+ * Note events applied at a fixed delay after their MIDI message arrived, on TB3 CCR3
+ *
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define SIZE_SCHED        8                     // queued events, must be a power of 2
+#define SCHED_MASK        (SIZE_SCHED - 1)
+#define SCHED_DELAY_CNT   ((unsigned int)(SMCLK_FREQ / 1000000 * SCHED_DELAY_US))  // arrival to output in TB3 counts
+#define SCHED_MARGIN      64                    // TB3 counts, closer than this an event is applied at once
+
+// event types
+#define SCHED_NOTE        1                     // pitch DAC, HARD SYNC off, gate, trigger and envelope attack
+#define SCHED_OFF         2                     // gate down and envelope release, or the mute without ENV_OUT
+
+// envelope of a SCHED_NOTE
+#define SCHED_ENV_NONE    0                     // bend or re-sounded note, the envelope carries on
+#define SCHED_ENV_ON      1                     // new note, no other note held
+#define SCHED_ENV_LEGATO  2                     // new note while another is held
+
+#if SCHED_DELAY_US < 100 || SCHED_DELAY_US > 1300
+  #error SCHED_DELAY_US must be 100 to 1300, the delay must stay below half a TB3 rollover at 24 MHz
+#endif
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// one queued event
+struct sched_evt {
+    unsigned int time;                          // TB3R to apply it at
+    unsigned int pitch;                         // 1/16 DAC LSB, SCHED_NOTE only
+    unsigned char type;                         // SCHED_*
+    unsigned char retrig;                       // SCHED_NOTE of a new note, send a trigger
+    unsigned char env;                          // SCHED_ENV_* of a SCHED_NOTE
+    unsigned char velocity;                     // its note velocity for the envelope
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned int sched_late;                 // events applied late, the main loop got to them after their time
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void schedNote(unsigned int pitch, unsigned char retrig, unsigned int time);   // Sound a pitch SCHED_DELAY_CNT after a message at time
+void schedNoteOn(unsigned int pitch, unsigned char velocity, unsigned char legato, unsigned int time);  // Sound a new note and start its envelope SCHED_DELAY_CNT after time
+unsigned char schedPending(void);                       // 1 while events wait in the queue
+void schedOff(unsigned int time);                       // Gate down SCHED_DELAY_CNT after a message at time
+void schedCancel(void);                                 // Drop every queued event, before a mute
+void schedFire(void);                                   // TB3 CCR3 compare, apply the event that is due
+
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,185 @@
+/*
+ * stress.c
+ *
+ * With MIDI_STRESS the UCA0 receiver listens to its own transmitter
+ * (UCLISTEN), and the TX interrupt reloads UCA0TXBUF as soon as it empties,
+ * so the input runs at 100% of 31250 baud with no gaps. Each scenario repeats
+ * a short pattern for STRESS_BYTES bytes:
+ *   1. notes with running status
+ *   2. clocks and active sensing inside the notes
+ *   3. a pitch bend flood over a held note
+ *   4. foreign SysEx with a clock inside it between notes
+ *
+ * Every pattern ends with no note held and the bend centered. After the last
+ * byte the result is checked and printed on the debug terminal:
+ *   - messages out of the parser against the messages sent
+ *   - UCOE overruns and UCFE framing errors
+ *   - the note stack is empty and the bend is back at 0
+ * A run is started with 's' on the debug terminal and ends with STRESS PASS
+ * or STRESS FAIL, so a regression in sustained throughput shows up as a FAIL.
+ *
+ */
+
+#include <stress.h>
+#include <mcu_vco.h>
+#include <midi.h>
+#include <midi_io.h>
+#include <midi_cc.h>
+
+#if MIDI_STRESS == 1
+
+
+//******************************************************************************
+// Scenarios *******************************************************************
+//******************************************************************************
+
+// repeated pattern, channel status bytes get midi_channel added when sent
+struct stress_scenario {
+    const unsigned char *bytes;
+    unsigned char len;
+    unsigned char msgs;             // parser messages per pattern, a SysEx counts every byte
+};
+
+static const unsigned char stress_notes[] = {
+    0x90, 60, 100, 64, 100, 67, 100, 60, 0, 64, 0, 67, 0 };
+
+static const unsigned char stress_clocks[] = {
+    0xF8, 0x90, 0xF8, 48, 0xFE, 90, 0xF8, 48, 0xF8, 0, 0xFE, 0xF8 };
+
+static const unsigned char stress_bend[] = {
+    0x90, 60, 100, 0xE0, 0x00, 0x40, 0x7F, 0x7F, 0x00, 0x00, 0x2A, 0x55, 0x00, 0x40, 0x80, 60, 0 };
+
+static const unsigned char stress_sysex[] = {
+    0x90, 72, 100, 0xF0, 0x7E, 0x7F, 0xF8, 0x06, 0x01, 0xF7, 0x80, 72, 0 };
+
+static const struct stress_scenario scenarios[] = {
+    { stress_notes,  sizeof(stress_notes),  6 },
+    { stress_clocks, sizeof(stress_clocks), 9 },
+    { stress_bend,   sizeof(stress_bend),   7 },
+    { stress_sysex,  sizeof(stress_sysex),  9 },
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+unsigned char f_stress = 0;
+volatile unsigned int stress_parsed = 0;
+
+static unsigned char scenario = 0;          // running scenario
+static unsigned char tx_pos = 0;            // next byte of the pattern
+static unsigned int  tx_left = 0;           // bytes left to send
+static unsigned int  errors_start = 0;      // UCA0 overruns and framing errors when the scenario started
+static unsigned char failed = 0;
+
+// state owned by main.c
+extern unsigned char midi_channel;
+extern unsigned char f_midi_note_on;
+extern unsigned char f_midi_note_off;
+extern struct note midi_notes[SIZE_NOTE_STACK];
+extern unsigned char ptr_note;
+extern int midi_pitch_bend_val;
+extern char debug_msg[SIZE_MESSAGE];
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Start a stress run from the first scenario
+void stressStart(void)
+{
+    if (f_stress) return;
+    scenario = 0;
+    failed = 0;
+    f_stress = 1;
+}
+
+
+// Send the next stress byte from the UCA0 TX interrupt
+void stressTxNext(void)
+{
+    const struct stress_scenario *s = &scenarios[scenario];
+    unsigned char byte;
+
+    if (tx_left == 0)
+    {
+        UCA0IE &= ~UCTXIE;
+        f_stress = 4;
+        return;
+    }
+
+    byte = s->bytes[tx_pos];
+    if (byte >= MIDI_NOTE_OFF_BASE && byte < MIDI_SYS_EXCLUSIVE) byte |= midi_channel;
+    UCA0TXBUF = byte;
+
+    if (++tx_pos == s->len) tx_pos = 0;
+    tx_left--;
+}
+
+
+// Run one step of the stress run from the main loop
+void stressService(void)
+{
+    const struct stress_scenario *s = &scenarios[scenario];
+    unsigned int reps = STRESS_BYTES / s->len;
+
+    switch (f_stress)
+    {
+        case 1:  // start a scenario
+            if (UCA1IE & UCTXIE) break;         // let the last report go out first
+            stress_parsed  = 0;
+            errors_start = uart_errors[0].overruns + uart_errors[0].framing;
+            tx_pos  = 0;
+            tx_left = reps * s->len;
+            UCA0STATW |= UCLISTEN;              // TX fed back to RX, P1.6 ignored
+            f_stress = 2;
+            UCA0IE |= UCTXIE;
+            break;
+
+        case 2:  // sending
+            break;
+
+        case 4:  // wait for the last byte and for the main loop to catch up
+            if (UCA0STATW & UCBUSY) break;
+            if (f_midi_note_on || f_midi_note_off || coal_pitch.dirty) break;
+            if (UCA1IE & UCTXIE) break;
+            f_stress = 8;
+            break;
+
+        case 8:  // check the scenario
+        {
+            unsigned int sent = reps * s->msgs;
+            unsigned int ovr  = uart_errors[0].overruns + uart_errors[0].framing - errors_start;
+            unsigned char ok  = stress_parsed == sent && ovr == 0
+                                && ptr_note == 0 && !midi_notes[0].on && midi_pitch_bend_val == 0;
+
+            if (!ok) failed = 1;
+            sprintf(debug_msg, "S%d %d/%d o%d %s\r\n", scenario + 1, stress_parsed, sent, ovr, ok ? "PASS" : "FAIL");
+            UCA1IE |= UCTXIE;
+
+            scenario++;
+            f_stress = (scenario < NUM_SCENARIOS) ? 1 : 16;
+            break;
+        }
+
+        case 16:  // report the run
+            if (UCA1IE & UCTXIE) break;
+            UCA0STATW &= ~UCLISTEN;
+            sprintf(debug_msg, "STRESS %s\r\n", failed ? "FAIL" : "PASS");
+            UCA1IE |= UCTXIE;
+            f_stress = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+#endif
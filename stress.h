@@ -0,0 +1,41 @@
+/*
+ * stress.h
+ *
+ * MIDI input stress run over the UCA0 loopback, MIDI_STRESS build only
+ *
+ */
+
+#ifndef STRESS_H_
+#define STRESS_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define STRESS_BYTES      6250      // bytes per scenario, 2 s at 31250 baud
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern unsigned char f_stress;                  // stress run flag, advanced by USCI_A0_ISR and stressService
+extern volatile unsigned int stress_parsed;     // messages out of the parser in the running scenario
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void stressStart(void);                                 // Start a stress run from the first scenario
+void stressTxNext(void);                                // Send the next stress byte from the UCA0 TX interrupt
+void stressService(void);                               // Run one step of the stress run from the main loop
+
+
+#endif /* STRESS_H_ */
@@ -0,0 +1,278 @@
+/*
+ * sysex.c
+ *
+ * Restores are decoded one byte at a time as they arrive and written straight
+ * into the FRAM stage, so a block never has to fit in RAM. The last three
+ * bytes before F7 are the CRC, so data bytes go through a three byte delay
+ * line before they are unpacked. Dumps are packed the same way, one byte per
+ * UCA0 TX interrupt, reading the block directly from FRAM. Universal SysEx
+ * (7E, 7F) goes to the MIDI Tuning Standard receiver in mts.c.
+ *
+ */
+
+#include <sysex.h>
+#include <midi.h>
+#include <midi_io.h>
+#include <fram_store.h>
+#include <mts.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+// receive states
+#define SX_IDLE     0       // not ours or ignored until the next F0
+#define SX_ID       1
+#define SX_DEV      2
+#define SX_CMD      3
+#define SX_BLOCK    4
+#define SX_DATA     5
+#define SX_END      6       // complete request, waiting for F7
+#define SX_MTS      7       // universal SysEx, fed to mts.c
+
+// transmit states
+#define TX_IDLE     0
+#define TX_HEADER   1
+#define TX_DATA     2
+#define TX_CRC      3
+#define TX_END      4
+
+#define SIZE_SYSEX_HEADER   5
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+volatile unsigned char f_sysex_commit = 0;
+unsigned int sysex_errors = 0;
+
+// receive
+static unsigned char rx_state = SX_IDLE;
+static unsigned char rx_cmd;
+static unsigned char rx_block;
+static unsigned int  rx_len;            // unpacked bytes written to the stage
+static unsigned int  rx_crc;
+static unsigned char rx_delay[3];       // last three raw bytes, the CRC once F7 arrives
+static unsigned char rx_delay_cnt;
+static unsigned char rx_msbs;           // MSB byte of the current packed group
+static unsigned char rx_pack;           // position in the packed group, 0 = MSB byte
+static unsigned char rx_overflow;
+
+// transmit
+static unsigned char tx_state = TX_IDLE;
+static unsigned char tx_header[SIZE_SYSEX_HEADER];
+static unsigned char tx_pos;
+static unsigned int  tx_len;            // bytes of the block sent
+static unsigned int  tx_crc;
+static unsigned char tx_pack;           // position in the packed group, 0 = MSB byte
+
+extern unsigned char midi_channel;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Queue a reply, DATA replies stream the block
+static void sysexTxStart(unsigned char cmd, unsigned char block)
+{
+    if (tx_state != TX_IDLE) return;    // one reply at a time
+
+    tx_header[0] = MIDI_SYS_EXCLUSIVE;
+    tx_header[1] = SYSEX_ID;
+    tx_header[2] = midi_channel;
+    tx_header[3] = cmd;
+    tx_header[4] = block;
+    tx_pos   = 0;
+    tx_len   = 0;
+    tx_crc   = 0xFFFF;
+    tx_pack  = 0;
+    tx_state = TX_HEADER;
+    UCA0IE |= UCTXIE;                   // TX interrupt pulls the bytes out
+}
+
+
+// Unpack one raw payload byte into the stage
+static void sysexUnpack(unsigned char byte)
+{
+    if (rx_pack == 0)
+    {
+        rx_msbs = byte;
+    }
+    else
+    {
+        byte |= ((rx_msbs >> (rx_pack - 1)) & 0x01) << 7;
+        if (rx_len < framBlockSize(rx_block))
+        {
+            fram_stage[rx_len++] = byte;
+            rx_crc = crc16(rx_crc, byte);
+        }
+        else rx_overflow = 1;
+    }
+    if (++rx_pack == 8) rx_pack = 0;
+}
+
+
+// Check a complete DATA message and hand it to the main loop
+static void sysexRxDone(void)
+{
+    unsigned int crc = ((unsigned int)rx_delay[0] << 14) | ((unsigned int)rx_delay[1] << 7) | rx_delay[2];
+
+    if (rx_delay_cnt == 3 && !rx_overflow && rx_len == framBlockSize(rx_block) && crc == rx_crc)
+    {
+        framStage(rx_block, rx_len);
+        f_sysex_commit = 1;
+        sysexTxStart(SYSEX_CMD_ACK, rx_block);
+    }
+    else
+    {
+        sysex_errors++;
+        sysexTxStart(SYSEX_CMD_NAK, rx_block);
+    }
+}
+
+
+// Feed one received SysEx byte (F0, data or F7)
+void sysexRx(unsigned char byte)
+{
+    if (byte == MIDI_SYS_EXCLUSIVE)
+    {
+        rx_state = SX_ID;
+        return;
+    }
+
+    if (byte == MIDI_SYS_EXCLUSIVE_END)
+    {
+        if (rx_state == SX_DATA) sysexRxDone();
+        else if (rx_state == SX_MTS) mtsEnd();
+        else if (rx_state == SX_END && rx_cmd == SYSEX_CMD_DUMP_REQ) sysexTxStart(SYSEX_CMD_DATA, rx_block);
+        rx_state = SX_IDLE;
+        return;
+    }
+
+    switch (rx_state)
+    {
+        case SX_ID:
+            rx_state = SX_IDLE;
+            if (byte == SYSEX_ID) rx_state = SX_DEV;
+            else if (byte == MIDI_SYSEX_NON_REALTIME || byte == MIDI_SYSEX_REALTIME)
+            {
+                mtsStart(byte);
+                rx_state = SX_MTS;
+            }
+            break;
+
+        case SX_DEV:
+            rx_state = (byte == SYSEX_DEV_ALL || byte == midi_channel) ? SX_CMD : SX_IDLE;
+            break;
+
+        case SX_CMD:
+            rx_cmd   = byte;
+            rx_state = (byte == SYSEX_CMD_DUMP_REQ || byte == SYSEX_CMD_DATA) ? SX_BLOCK : SX_IDLE;
+            break;
+
+        case SX_BLOCK:
+            rx_block = byte;
+            rx_state = SX_IDLE;
+            if (framBlockSize(byte) == 0) break;
+            if (rx_cmd == SYSEX_CMD_DUMP_REQ)
+            {
+                rx_state = SX_END;
+            }
+            else if (framBlockSize(byte) > SIZE_FRAM_STAGE)
+            {
+                // the trace can be dumped but not restored
+                sysex_errors++;
+                sysexTxStart(SYSEX_CMD_NAK, byte);
+            }
+            else if (f_sysex_commit)
+            {
+                // stage still in use by the previous restore
+                sysex_errors++;
+                sysexTxStart(SYSEX_CMD_NAK, byte);
+            }
+            else
+            {
+                rx_len       = 0;
+                rx_crc       = 0xFFFF;
+                rx_delay_cnt = 0;
+                rx_pack      = 0;
+                rx_overflow  = 0;
+                rx_state     = SX_DATA;
+            }
+            break;
+
+        case SX_MTS:
+            mtsRx(byte);
+            break;
+
+        case SX_DATA:
+            if (rx_delay_cnt == 3) sysexUnpack(rx_delay[0]);
+            else rx_delay_cnt++;
+            rx_delay[0] = rx_delay[1];
+            rx_delay[1] = rx_delay[2];
+            rx_delay[2] = byte;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+// Next byte of the outgoing SysEx, -1 if none
+int sysexTxNext(void)
+{
+    unsigned char *block = framBlockAddr(tx_header[4]);
+    unsigned int   size  = framBlockSize(tx_header[4]);
+    unsigned char  byte;
+
+    switch (tx_state)
+    {
+        case TX_HEADER:
+            byte = tx_header[tx_pos++];
+            if (tx_pos == SIZE_SYSEX_HEADER) tx_state = (tx_header[3] == SYSEX_CMD_DATA) ? TX_DATA : TX_END;
+            return byte;
+
+        case TX_DATA:
+            if (tx_pack == 0)
+            {
+                // MSBs of the next group of up to 7 bytes
+                unsigned char i;
+                byte = 0;
+                for (i = 0; i < 7 && tx_len + i < size; i++)
+                {
+                    byte |= (block[tx_len + i] >> 7) << i;
+                }
+            }
+            else
+            {
+                byte = block[tx_len++];
+                tx_crc = crc16(tx_crc, byte);
+                byte &= 0x7F;
+                if (tx_len == size)
+                {
+                    tx_state = TX_CRC;
+                    tx_pos   = 0;
+                }
+            }
+            if (++tx_pack == 8) tx_pack = 0;
+            return byte;
+
+        case TX_CRC:
+            byte = (tx_crc >> (14 - 7 * tx_pos)) & 0x7F;
+            if (++tx_pos == 3) tx_state = TX_END;
+            return byte;
+
+        case TX_END:
+            tx_state = TX_IDLE;
+            return MIDI_SYS_EXCLUSIVE_END;
+
+        default:
+            return -1;
+    }
+}
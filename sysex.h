@@ -0,0 +1,55 @@
+/*
+ * sysex.h
+ *
+ * SysEx dump and restore of the FRAM blocks
+ *
+ * Messages (7-bit packed payload, CRC-16-CCITT of the unpacked block):
+ *   F0 7D dd 01 bb F7                      dump request for block bb
+ *   F0 7D dd 02 bb <packed> c2 c1 c0 F7    block data, CRC sent 7 bits per byte MSB first
+ *   F0 7D dd 03 bb F7                      ack, block restored
+ *   F0 7D dd 04 bb F7                      nak, block rejected
+ * dd is the unit's MIDI channel or 7F for all units. Packed data is sent in
+ * groups of up to 8 bytes: one byte with bit n = MSB of data byte n, then
+ * the 7 data bytes with their MSB cleared.
+ *
+ */
+
+#ifndef SYSEX_H_
+#define SYSEX_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define SYSEX_ID            0x7D    // non-commercial manufacturer ID
+#define SYSEX_DEV_ALL       0x7F
+
+#define SYSEX_CMD_DUMP_REQ  0x01
+#define SYSEX_CMD_DATA      0x02
+#define SYSEX_CMD_ACK       0x03
+#define SYSEX_CMD_NAK       0x04
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern volatile unsigned char f_sysex_commit;   // a restored block waits for the main loop
+extern unsigned int sysex_errors;               // rejected DATA messages
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void sysexRx(unsigned char byte);                       // Feed one received SysEx byte (F0, data or F7)
+int sysexTxNext(void);                                  // Next byte of the outgoing SysEx, -1 if none
+
+
+#endif /* SYSEX_H_ */
@@ -0,0 +1,144 @@
+/*
+ * timer_wheel.c
+ *
+ * Every timed behaviour shares the TB3 control tick through a hierarchical
+ * timer wheel. Level 0 has a slot per tick, level 1 a slot per 32 ticks and
+ * level 2 a slot per 1024 ticks. A timer goes into the lowest level whose
+ * span covers its delay, and a whole slot of the level above is moved down
+ * each time the level below wraps, so every timer ends up in level 0 in time
+ * for its tick.
+ *
+ * Timers are linked through the caller's own struct, so arming and
+ * cancelling are a handful of pointer writes with no search and no
+ * allocation. Callbacks run in the tick interrupt and should only set a flag
+ * for the main loop, the way the other ISRs do.
+ *
+ */
+
+#include <timer_wheel.h>
+#include <mcu_vco.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+static struct sw_timer *wheel[TW_LEVELS][TW_SLOTS];
+
+// state owned by main.c
+extern volatile unsigned int ctrl_ticks;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Link a timer into the slot for its expiry, interrupts must be off
+RAM_FUNC(timerLink)
+static void timerLink(struct sw_timer *t)
+{
+    unsigned int delta = t->expires - ctrl_ticks;
+    struct sw_timer **slot;
+
+    if (delta < TW_SLOTS)
+        slot = &wheel[0][t->expires & TW_SLOT_MASK];
+    else if (delta < (TW_SLOTS << TW_SLOT_BITS))
+        slot = &wheel[1][(t->expires >> TW_SLOT_BITS) & TW_SLOT_MASK];
+    else
+        slot = &wheel[2][(t->expires >> (2 * TW_SLOT_BITS)) & TW_SLOT_MASK];
+
+    t->next = *slot;
+    if (t->next) t->next->pprev = &t->next;
+    t->pprev = slot;
+    *slot = t;
+}
+
+
+// Unlink a timer, interrupts must be off
+RAM_FUNC(timerUnlink)
+static void timerUnlink(struct sw_timer *t)
+{
+    if (!t->pprev) return;
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->pprev = 0;
+}
+
+
+// (Re)arm a timer to call fn after delay ticks, then every period ticks if period is not 0
+RAM_FUNC(timerArm)
+void timerArm(struct sw_timer *t, unsigned int delay, unsigned int period, void (*fn)(void))
+{
+    unsigned short state;
+
+    if (delay == 0) delay = 1;                  // this tick's slot has already run
+    if (delay > TW_MAX_DELAY) delay = TW_MAX_DELAY;
+    if (period > TW_MAX_DELAY) period = TW_MAX_DELAY;
+
+    // armed from the main loop and the MIDI ISRs
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    timerUnlink(t);
+    t->expires = ctrl_ticks + delay;
+    t->period  = period;
+    t->fn      = fn;
+    timerLink(t);
+    __set_interrupt_state(state);
+}
+
+
+// Stop a timer, safe if it is not armed
+void timerCancel(struct sw_timer *t)
+{
+    unsigned short state;
+
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    timerUnlink(t);
+    __set_interrupt_state(state);
+}
+
+
+// Move every timer of a slot down to the levels below
+static void timerCascade(struct sw_timer **slot)
+{
+    struct sw_timer *t = *slot;
+
+    *slot = 0;
+    while (t)
+    {
+        struct sw_timer *next = t->next;
+        timerLink(t);
+        t = next;
+    }
+}
+
+
+// Run the timers due this tick, called from the TB3 CCR0 interrupt after ctrl_ticks moved on
+void timerTick(void)
+{
+    unsigned int now = ctrl_ticks;
+    struct sw_timer **slot = &wheel[0][now & TW_SLOT_MASK];
+
+    // top level first, its timers may land in the level 1 slot cascaded next
+    if ((now & TW_SLOT_MASK) == 0)
+    {
+        if (((now >> TW_SLOT_BITS) & TW_SLOT_MASK) == 0)
+            timerCascade(&wheel[2][(now >> (2 * TW_SLOT_BITS)) & TW_SLOT_MASK]);
+        timerCascade(&wheel[1][(now >> TW_SLOT_BITS) & TW_SLOT_MASK]);
+    }
+
+    while (*slot)
+    {
+        struct sw_timer *t = *slot;
+
+        timerUnlink(t);
+        if (t->period)
+        {
+            t->expires += t->period;
+            timerLink(t);
+        }
+        t->fn();
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * timer_wheel.h
+ *
+ * Software timers on the TB3 control tick
+ *
+ */
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define TW_SLOT_BITS      5                         // 32 slots per level
+#define TW_SLOTS          (1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK      (TW_SLOTS - 1)
+#define TW_LEVELS         3                         // 1 ms, 32 ms and 1.024 s slots
+#define TW_MAX_DELAY      32767                     // longest delay in ticks, ~32 s
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// timer owned by the caller, only touched through the functions below
+struct sw_timer {
+    struct sw_timer *next;
+    struct sw_timer **pprev;        // link pointing at this timer, 0 while not armed
+    unsigned int expires;           // ctrl_ticks when it fires
+    unsigned int period;            // ticks between calls, 0 = one-shot
+    void (*fn)(void);               // called from the tick interrupt, keep it short
+};
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void timerArm(struct sw_timer *t, unsigned int delay, unsigned int period, void (*fn)(void));  // (Re)arm a timer
+void timerCancel(struct sw_timer *t);                   // Stop a timer, safe if it is not armed
+void timerTick(void);                                   // Run the timers due this tick, from the TB3 CCR0 interrupt
+
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,13 @@
+/*
+ * msp430.h
+ *
+ * Host stand-in for the device header, so tools/tune_bench.c can build the
+ * tune code with the host compiler. The firmware headers only use register
+ * names inside macros, which the host build never expands.
+ *
+ */
+
+#ifndef MSP430_HOST_H_
+#define MSP430_HOST_H_
+
+#endif /* MSP430_HOST_H_ */
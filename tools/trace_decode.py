@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+trace_decode.py
+
+Decode the flight recorder of the MCU VCO from a SysEx dump of FRAM block 3.
+
+Request the dump with F0 7D 7F 01 03 F7 from any SysEx tool, save the reply
+to a .syx file and run:
+
+    python3 trace_decode.py dump.syx
+
+Events are printed oldest first. Times are ms since the reset that started
+each boot.
+"""
+
+import struct
+import sys
+
+SYSEX_ID = 0x7D
+SYSEX_CMD_DATA = 0x02
+FRAM_BLOCK_TRACE = 3
+SIZE_TRACE = 512
+
+TRACE_RESET = 1
+TRACE_WRAP = 2
+TRACE_MIDI = 3
+TRACE_NOTE_ON = 4
+TRACE_NOTE_OFF = 5
+TRACE_ALL_OFF = 6
+TRACE_DAC = 7
+TRACE_TUNE = 8
+
+RESET_CAUSE = {
+    0x00: "none", 0x02: "brownout", 0x04: "RST/NMI pin", 0x06: "software BOR",
+    0x08: "LPM3.5/4.5 wakeup", 0x0A: "security violation", 0x0E: "SVSH",
+    0x14: "software POR", 0x16: "watchdog timeout", 0x18: "watchdog password",
+    0x1A: "FRAM ctl password", 0x1C: "FRAM bit error", 0x1E: "peripheral fetch",
+    0x20: "PMM password", 0x24: "FLL unlock",
+}
+
+TUNE_SRC = {0: "EXP FREQ offset", 1: "EXP SCALE", 2: "background step", 3: "FLL lock change", 4: "tune failed, no edges"}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def unpack(payload):
+    # groups of one MSB byte followed by up to 7 data bytes
+    out = bytearray()
+    for i in range(0, len(payload), 8):
+        msbs = payload[i]
+        for n, byte in enumerate(payload[i + 1:i + 8]):
+            out.append(byte | (((msbs >> n) & 1) << 7))
+    return bytes(out)
+
+
+def read_block(raw):
+    start = raw.find(bytes([0xF0, SYSEX_ID]))
+    end = raw.find(b"\xF7", start)
+    if start < 0 or end < 0:
+        sys.exit("no SysEx message found")
+    msg = raw[start:end]
+    if msg[3] != SYSEX_CMD_DATA or msg[4] != FRAM_BLOCK_TRACE:
+        sys.exit("not a trace dump (cmd %02X block %02X)" % (msg[3], msg[4]))
+
+    data = unpack(msg[5:-3])
+    crc = (msg[-3] << 14) | (msg[-2] << 7) | msg[-1]
+    if crc16(data) != crc:
+        sys.exit("CRC mismatch, dump is damaged")
+    return data
+
+
+def describe(rtype, a, b):
+    if rtype == TRACE_RESET:
+        return "RESET      %s (SYSRSTIV %02X), boot %d" % (RESET_CAUSE.get(a, "?"), a, b)
+    if rtype == TRACE_MIDI:
+        return "MIDI       %02X %02X %02X" % (a, b & 0xFF, b >> 8)
+    if rtype == TRACE_NOTE_ON:
+        return "NOTE ON    %d, slot %d" % (a, b)
+    if rtype == TRACE_NOTE_OFF:
+        return "NOTE OFF   %d, ptr_note %d" % (a, b)
+    if rtype == TRACE_ALL_OFF:
+        return "ALL OFF"
+    if rtype == TRACE_DAC:
+        return "DAC%d       %d" % (a, b)
+    if rtype == TRACE_TUNE:
+        value = b - 0x10000 if a == 3 and b & 0x8000 else b
+        return "TUNE       %s %d" % (TUNE_SRC.get(a, "?"), value)
+    return "type %d     %02X %04X" % (rtype, a, b)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        data = read_block(f.read())
+
+    boots, head = struct.unpack_from("<HH", data, 0)
+    recs = [struct.unpack_from("<HBBH", data, 4 + 6 * i) for i in range(SIZE_TRACE)]
+    print("%d resets recorded" % boots)
+
+    # oldest first, empty slots have type 0
+    wraps = 0
+    for i in range(SIZE_TRACE):
+        time, rtype, a, b = recs[(head + i) % SIZE_TRACE]
+        if rtype == 0:
+            continue
+        if rtype == TRACE_RESET:
+            wraps = 0
+            print()
+        elif rtype == TRACE_WRAP:
+            wraps += 1
+            continue
+        print("%10.3f s  %s" % ((wraps * 65536 + time) / 1000.0, describe(rtype, a, b)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,233 @@
+/*
+ * tune_bench.c
+ *
+ * Host benchmark of the start-up tune. It builds tune.c, the decisions the
+ * firmware runs, with the host compiler and drives them with BENCH_UNITS
+ * random virtual VCOs per scenario, so a change to the tune algorithm can be
+ * judged without hardware. From the repo root:
+ *
+ *     gcc -I. -Itools/host -o tune_bench tools/tune_bench.c tune.c midi_luts.c -lm
+ *     ./tune_bench
+ *
+ * tools/host/msp430.h stands in for the device header, cfg.h and mcu_vco.h
+ * only need it for register macros the tune code does not use.
+ *
+ * A virtual VCO follows
+ *
+ *   octaves above note 0 = DAC0/BENCH_DAC_PER_OCT * scale * (1 - EXP SCALE trim)
+ *                        + (EXP FREQ offset - unit offset - drift*t)/BENCH_OFF_PER_OCT
+ *   f = 8.1758 Hz * 2^octaves / (1 + f/rolloff)
+ *
+ * and a measurement is one period in tune clocks plus optional noise, taking
+ * BENCH_MEAS_PERIODS periods of simulated time like the real counter. Each
+ * scenario adds one imperfection (count jitter, high frequency rolloff,
+ * offset drift) and the last one adds them all.
+ *
+ * Per scenario it reports measurements, simulated tune time and the worst
+ * error over the C notes 0-120 in 1/10 cent, averaged and worst case over the
+ * units that converged, plus the units that did not converge in
+ * BENCH_MAX_ITER measurements. The random units are the same every run, so a
+ * change to the tune algorithm is judged on the same units.
+ *
+ */
+
+#include <tune.h>
+#include <mcu_vco.h>
+#include <midi_luts.h>
+#include <math.h>
+#include <stdio.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define BENCH_UNITS         200         // random units per scenario
+#define BENCH_MAX_ITER      1000        // measurements per stage before a unit counts as failed
+#define BENCH_MEAS_PERIODS  (NUM_IGNORED + 2)   // VCO periods per measurement, ignored + start + stop
+
+// virtual VCO
+#define BENCH_DAC_PER_OCT   409.5f      // pitch DAC steps per octave, 10 octaves over 4095
+#define BENCH_OFF_PER_OCT   2000.0f     // EXP FREQ offset DAC steps per octave
+#define BENCH_SCALE_PER_LSB 0.0002f     // relative scale change per EXP SCALE DAC step
+#define BENCH_OFF_SPREAD    200.0f      // +/- EXP FREQ offset spread around INIT_EXP_OFFSET
+#define BENCH_SCALE_SPREAD  0.04f       // +/- scale error
+#define BENCH_ROLL_MIN      20000.0f    // high frequency rolloff corner, Hz
+#define BENCH_ROLL_SPREAD   40000.0f
+#define BENCH_JITTER        2.0f        // +/- count noise per measurement, triangular
+#define BENCH_DRIFT         0.05f       // +/- EXP FREQ offset drift, DAC steps per second
+
+
+
+//******************************************************************************
+// Scenarios *******************************************************************
+//******************************************************************************
+
+struct bench_set {
+    const char *name;
+    unsigned char jitter;
+    unsigned char rolloff;
+    unsigned char drift;
+};
+
+static const struct bench_set bench_sets[] = {
+    { "ideal",   0, 0, 0 },
+    { "jitter",  1, 0, 0 },
+    { "rolloff", 0, 1, 0 },
+    { "drift",   0, 0, 1 },
+    { "all",     1, 1, 1 },
+};
+
+#define NUM_BENCH_SETS (sizeof(bench_sets) / sizeof(bench_sets[0]))
+
+// one virtual VCO
+struct vvco {
+    float offset;                   // EXP FREQ offset DAC value that puts note 0 in tune
+    float scale;                    // V/oct scale, 1 = exact
+    float rolloff;                  // Hz
+    float jitter;                   // count noise amplitude
+    float drift;                    // offset DAC steps per second
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+static unsigned long bench_seed;
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Uniform random number in [-1, 1), 32-bit LCG whatever the host long is
+static float benchRand(void)
+{
+    bench_seed = (bench_seed * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+    return (float)((bench_seed >> 8) & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+
+// Output frequency of a virtual VCO at time t
+static float vcoFreq(const struct vvco *v, unsigned int dac0, unsigned int expoff, unsigned int exp, float t)
+{
+    float oct = (float)dac0 / BENCH_DAC_PER_OCT * v->scale * (1.0f - ((float)exp - DAC_OUT_1V25) * BENCH_SCALE_PER_LSB)
+              + ((float)expoff - v->offset - v->drift * t) / BENCH_OFF_PER_OCT;
+    float f = 8.1758f * powf(2.0f, oct);
+
+    return f / (1.0f + f / v->rolloff);
+}
+
+
+// One measurement in tune clocks, advances the simulated time
+static unsigned int vcoMeasure(const struct vvco *v, unsigned int dac0, unsigned int expoff, unsigned int exp, float *t)
+{
+    float f = vcoFreq(v, dac0, expoff, exp, *t);
+    float cnt = (float)TUNE_CLK_FREQ / f + v->jitter * (benchRand() + benchRand()) * 0.5f + 0.5f;
+
+    *t += BENCH_MEAS_PERIODS / f;
+    if (cnt < 0.0f) return 0;
+    if (cnt > 65535.0f) return 0xFFFF;     // the 16-bit counter would have wrapped
+    return (unsigned int)cnt;
+}
+
+
+// Tune one unit like main.c does, returns 1 if both stages converged
+static unsigned char benchUnit(const struct vvco *v, unsigned int *iter, float *t, unsigned int *err)
+{
+    unsigned int expoff = INIT_EXP_OFFSET;
+    unsigned int exp = DAC_OUT_1V25;
+    unsigned int n = 0;
+    signed char step = 1;
+    float worst = 0.0f;
+    unsigned char note;
+
+    *t = 0.0f;
+
+    // EXP FREQ offset at note 0
+    while (step && n < BENCH_MAX_ITER)
+    {
+        step = tuneOffsetStep(vcoMeasure(v, 0, expoff, exp, t));
+        expoff += step;
+        n++;
+    }
+    *iter = n;
+    if (step) return 0;
+
+    // EXP SCALE at A4
+    step = 1;
+    n = 0;
+    while (step && n < BENCH_MAX_ITER)
+    {
+        step = tuneScaleStep(vcoMeasure(v, conv_midi_to_dac(69), expoff, exp, t));
+        exp += step;
+        n++;
+    }
+    *iter += n;
+    if (step) return 0;
+
+    // worst error in cents over the octaves, right after the tune
+    for (note = 0; note <= 120; note += 12)
+    {
+        float ratio = vcoFreq(v, conv_midi_to_dac(note), expoff, exp, *t) * 256.0f / conv_midi_to_freq(note);
+        float cents = fabsf(logf(ratio) * 1731.234f);       // 1200/ln(2)
+        if (cents > worst) worst = cents;
+    }
+    *err = (worst > 3276.0f) ? 32767 : (unsigned int)(worst * 10.0f);
+    return 1;
+}
+
+
+// Run every scenario and print a table
+int main(void)
+{
+    unsigned char s;
+
+    printf("%-8s %9s %9s %10s %10s %10s %10s %8s\n",
+           "scenario", "meas avg", "meas max", "time avg s", "time max s", "err avg c", "err max c", "failed");
+
+    for (s = 0; s < NUM_BENCH_SETS; s++)
+    {
+        const struct bench_set *set = &bench_sets[s];
+        unsigned long iter_sum = 0, err_sum = 0;
+        unsigned int iter_max = 0, err_max = 0;
+        float time_sum = 0.0f, time_max = 0.0f;
+        unsigned int ok = 0, div, u;
+
+        bench_seed = 12345;                 // same units in every scenario and every run
+
+        for (u = 0; u < BENCH_UNITS; u++)
+        {
+            struct vvco v;
+            unsigned int iter, err;
+            float t;
+
+            v.offset  = INIT_EXP_OFFSET + BENCH_OFF_SPREAD * benchRand();
+            v.scale   = 1.0f + BENCH_SCALE_SPREAD * benchRand();
+            v.rolloff = set->rolloff ? BENCH_ROLL_MIN + BENCH_ROLL_SPREAD * fabsf(benchRand()) : 1.0e9f;
+            v.jitter  = set->jitter ? BENCH_JITTER : 0.0f;
+            v.drift   = set->drift ? BENCH_DRIFT * benchRand() : 0.0f;
+
+            if (!benchUnit(&v, &iter, &t, &err)) continue;
+
+            ok++;
+            iter_sum += iter;
+            time_sum += t;
+            err_sum  += err;
+            if (iter > iter_max) iter_max = iter;
+            if (t > time_max)    time_max = t;
+            if (err > err_max)   err_max = err;
+        }
+
+        // averages over the units that converged, none is not a division by zero
+        div = ok ? ok : 1;
+
+        printf("%-8s %9lu %9u %10.1f %10.1f %10.1f %10.1f %4u/%u\n",
+               set->name, iter_sum / div, iter_max, time_sum / div, time_max,
+               (float)err_sum / div / 10.0f, err_max / 10.0f, BENCH_UNITS - ok, BENCH_UNITS);
+    }
+    return 0;
+}
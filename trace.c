@@ -0,0 +1,62 @@
+/*
+ * trace.c
+ *
+ * The trace ring lives in .TI.persistent, so records are written in place
+ * and nothing is lost on reset or power loss. A record is six bytes and
+ * FRAM writes cost about the same as RAM, so appending one is a few dozen
+ * cycles with interrupts held off, cheap enough to leave on in production.
+ * Streams that would overwrite the ring within a second stay out of it:
+ * real-time and SysEx bytes, pitch bend and pressure messages, and pitch DAC
+ * writes smaller than TRACE_DAC_STEP.
+ *
+ * Times are control ticks (ms) since the last reset. TRACE_WRAP marks every
+ * 65.536 s and TRACE_RESET starts a new time base with the reset cause from
+ * SYSRSTIV. Read the ring out with a dump request for FRAM_BLOCK_TRACE
+ * (F0 7D 7F 01 03 F7) and decode the reply with tools/trace_decode.py.
+ *
+ */
+
+#include <trace.h>
+#include <fram_store.h>
+#include <mcu_vco.h>
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+FRAM_PERSISTENT(trace_log)
+struct trace_log trace_log = { 0, 0, { { 0 } } };
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Append a record to the ring, overwriting the oldest once it is full
+RAM_FUNC(traceRec)
+void traceRec(unsigned char type, unsigned char a, unsigned int b)
+{
+    unsigned short state;
+    struct trace_rec *r;
+
+    // called from the main loop and the ISRs
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    r = &trace_log.rec[trace_log.head & TRACE_MASK];
+    r->time = ctrl_ticks;
+    r->type = type;
+    r->a    = a;
+    r->b    = b;
+    trace_log.head = (trace_log.head + 1) & TRACE_MASK;
+    __set_interrupt_state(state);
+}
+
+
+// Record a reset, reset_cause is the first SYSRSTIV value read after boot
+void traceBoot(unsigned int reset_cause)
+{
+    trace_log.boots++;
+    traceRec(TRACE_RESET, (unsigned char)reset_cause, trace_log.boots);
+}
@@ -0,0 +1,87 @@
+/*
+ * trace.h
+ *
+ * Flight recorder: timestamped event ring in FRAM that survives reset and
+ * power loss, read out as FRAM block 3 over SysEx
+ *
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define SIZE_TRACE        512                   // records in the ring, must be a power of 2
+#define TRACE_MASK        (SIZE_TRACE - 1)
+#define TRACE_DAC_STEP    17                    // pitch DAC LSB, half a semitone
+
+// record types            a                     b
+#define TRACE_RESET       1     // SYSRSTIV          boot count
+#define TRACE_WRAP        2     // 0                 0, ctrl_ticks wrapped
+#define TRACE_MIDI        3     // status            data0 | data1 << 8
+#define TRACE_NOTE_ON     4     // note              ptr_note, stack slot of the note
+#define TRACE_NOTE_OFF    5     // note              ptr_note after the note left the stack
+#define TRACE_ALL_OFF     6     // 0                 0
+#define TRACE_DAC         7     // DAC 0-3           value, the pitch DAC only on a move of TRACE_DAC_STEP
+#define TRACE_TUNE        8     // TRACE_TUNE_*      result
+
+// TRACE_TUNE sources
+#define TRACE_TUNE_OFFSET 0     // start-up tune done, EXP FREQ offset
+#define TRACE_TUNE_SCALE  1     // start-up tune done, EXP SCALE
+#define TRACE_TUNE_BG     2     // background EXP FREQ step
+#define TRACE_TUNE_FLL    3     // FLL lock change, b = error in 0.1 cent
+#define TRACE_TUNE_FAIL   4     // start-up tune stopped, no edges from the VCO
+
+#if FLIGHT_TRACE == 1
+    #define TRACE_EVT(type, a, b)   traceRec((type), (a), (b))
+#else
+    #define TRACE_EVT(type, a, b)   do { } while (0)
+#endif
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// one event, 6 bytes
+struct trace_rec {
+    unsigned int time;          // ctrl_ticks (ms) when recorded
+    unsigned char type;         // TRACE_*
+    unsigned char a;
+    unsigned int b;
+};
+
+// the whole recorder, dumped as one block
+struct trace_log {
+    unsigned int boots;         // resets since the ring was cleared
+    unsigned int head;          // next record to write, the oldest once the ring is full
+    struct trace_rec rec[SIZE_TRACE];
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern struct trace_log trace_log;
+extern volatile unsigned int ctrl_ticks;        // control ticks since reset, owned by main.c
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void traceRec(unsigned char type, unsigned char a, unsigned int b);     // Append a record to the ring
+void traceBoot(unsigned int reset_cause);               // Record a reset
+
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,328 @@
+/*
+ * track.c
+ *
+ * With PITCH_TRACK the frequency counter follows whatever oscillator drives
+ * P2.2 while the unit is playing, and the pitch goes out as NOTE ON, NOTE OFF
+ * and pitch bend on UCA0 TX, so another synth can be slaved to a free running
+ * analog oscillator.
+ *
+ * TB0 runs free at TRACK_CLK_FREQ and TB1 counts edges on TB1CLK, preloaded
+ * so it overflows after each edge. Timer1_B1_ISR stamps TB0R there and rings
+ * the time since the last stamp. Interrupt latency lands in a single stamp
+ * and is spread over the next one, so the main loop takes the median of the
+ * last three periods, which follows a new pitch after two periods and drops a
+ * late stamp. Above TRACK_MIN_CNT counts per period every edge is stamped,
+ * which covers the whole tracked range. Faster signals are stamped every few
+ * edges to bound the interrupt rate.
+ *
+ * A period is turned into 1/256 semitone by shifting it into the octave of
+ * note 0 and interpolating between the semitone periods of that octave,
+ * within a cent of the log. The note only changes once the pitch is
+ * TRACK_HYST past halfway to the next one, and the deviation from it goes
+ * out as a bend, at most one per control tick to leave room on the wire. The
+ * new note is sent before the old note off, legato on a mono synth.
+ *
+ * Every message carries its status byte and goes out between forwarded THRU
+ * messages. The THRU output sends its running status again after one, so a
+ * bend every tick does not cost the forwarded notes their status.
+ *
+ */
+
+#include <track.h>
+#include <mcu_vco.h>
+#include <midi.h>
+#include <midi_luts.h>
+
+#if PITCH_TRACK == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+volatile unsigned char f_track = 0;
+unsigned char track_note = TRACK_NONE;
+unsigned int track_drops = 0;
+
+static struct track_stamp ring[SIZE_TRACK_RING];
+static volatile unsigned char ring_head = 0;    // next free slot, free running
+static unsigned char ring_tail = 0;             // oldest stamp
+
+static struct track_msg tx_q[SIZE_TRACK_TX];
+static volatile unsigned char tx_head = 0;      // next free message, free running
+static volatile unsigned char tx_tail = 0;      // message being sent
+static unsigned char tx_pos = 0;                // its next byte
+
+static unsigned char primed;                    // prev_t holds a stamp
+static unsigned int  prev_t;                    // TB0R of the last stamp
+static volatile unsigned int prev_tick;         // ctrl_ticks of the last stamp
+static unsigned char edges_run;                 // edges the running count spans
+static volatile unsigned char edges_set;        // edges per stamp from the next one on
+
+static unsigned long hist[3];                   // newest periods in 1/16 TB0 count
+static unsigned char n_hist;
+static unsigned long ref[13];                   // semitone periods of the octave of note 0, ref[12] = ref[0] / 2
+static int sent_dev;                            // deviation of the last bend
+static unsigned int bend_tick;                  // ctrl_ticks of the last bend
+
+// state owned by main.c
+extern volatile unsigned int ctrl_ticks;
+extern unsigned char midi_channel;
+#if DEBUG == 1
+    extern char debug_msg[SIZE_MESSAGE];
+#endif
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Queue one channel message and kick UCA0 TX
+static void trackSend(unsigned char status, unsigned char d1, unsigned char d2)
+{
+    struct track_msg *m;
+
+    if ((unsigned char)(tx_head - tx_tail) == SIZE_TRACK_TX)
+    {
+        track_drops++;
+        return;
+    }
+    m = &tx_q[tx_head & TRACK_TX_MASK];
+    m->b[0] = status | midi_channel;
+    m->b[1] = d1;
+    m->b[2] = d2;
+    tx_head++;
+    UCA0IE |= UCTXIE;
+}
+
+
+// Bend dev 1/256 semitone away from track_note
+static void trackBend(int dev)
+{
+    int bend = 8192 + (dev * 32) / TRACK_BEND_RANGE;
+
+    if (bend < 0) bend = 0;
+    if (bend > 16383) bend = 16383;
+    trackSend(MIDI_PITCH_BEND_BASE, bend & 0x7F, bend >> 7);
+    sent_dev  = dev;
+    bend_tick = ctrl_ticks;
+}
+
+
+// New note with its bend, then the old note off
+static void trackNote(unsigned char note, int dev)
+{
+    unsigned char old = track_note;
+
+    track_note = note;
+    trackBend(dev);
+    trackSend(MIDI_NOTE_ON_BASE, note, TRACK_VELOCITY);
+    if (old != TRACK_NONE) trackSend(MIDI_NOTE_OFF_BASE, old, 0);
+
+    #if DEBUG == 1
+        sprintf(debug_msg, "T N = %d ON\r\n", note);
+        UCA1IE |= UCTXIE;
+    #endif
+}
+
+
+// Note off, the signal is gone
+static void trackOff(void)
+{
+    if (track_note == TRACK_NONE) return;
+
+    trackSend(MIDI_NOTE_OFF_BASE, track_note, 0);
+    track_note = TRACK_NONE;
+
+    #if DEBUG == 1
+        sprintf(debug_msg, "T OFF\r\n");
+        UCA1IE |= UCTXIE;
+    #endif
+}
+
+
+// Pitch of a period in 1/256 semitone, -1 outside the tracked notes
+static int trackPitch(unsigned long per)
+{
+    unsigned char oct = 0;
+    unsigned char k = 0;
+    int pitch;
+
+    if (per > ref[0] || per == 0) return -1;
+
+    // into the octave of note 0, then the semitone below it
+    while (per <= ref[12])
+    {
+        per <<= 1;
+        oct++;
+    }
+    while (k < 11 && per <= ref[k + 1]) k++;
+
+    pitch = (oct * 12 + k) * 256 + (int)(((ref[k] - per) << 8) / (ref[k] - ref[k + 1]));
+    if (pitch < TRACK_LOW_NOTE * 256 - 128 || pitch > TRACK_HIGH_NOTE * 256 + 128) return -1;
+    return pitch;
+}
+
+
+// Median of the last three periods
+static unsigned long trackMedian(void)
+{
+    unsigned long a = hist[0], b = hist[1], c = hist[2];
+
+    if (a > b) { unsigned long t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return (a > b) ? a : b;
+}
+
+
+// Take the frequency counter and start stamping edges
+void trackStart(void)
+{
+    unsigned char k;
+
+    // periods of C4 to B4 in 1/16 count, shifted down to the octave of note 0
+    for (k = 0; k < 12; k++)
+    {
+        unsigned long f = conv_midi_to_freq(60 + k);
+        unsigned long q = ((unsigned long)TRACK_CLK_FREQ << 8) / f;
+        unsigned long r = ((unsigned long)TRACK_CLK_FREQ << 8) % f;
+
+        ref[k] = ((q << 4) + ((r << 4) / f)) << 5;
+    }
+    ref[12] = ref[0] >> 1;
+
+    primed    = 0;
+    n_hist    = 0;
+    edges_run = 1;
+    edges_set = 1;
+    ring_tail = ring_head;
+    prev_tick = ctrl_ticks;
+    f_track   = 1;
+    initTrackCtr();
+}
+
+
+// Note off and hand the frequency counter back
+void trackStop(void)
+{
+    TB0CTL = 0;
+    TB1CTL = 0;
+    f_track = 0;
+    trackOff();
+}
+
+
+// Stamp the edges just counted, from Timer1_B1_ISR
+void trackEdge(void)
+{
+    unsigned int t    = TB0R;
+    unsigned int tick = ctrl_ticks;
+    unsigned char edges = edges_run;
+
+    // the next count spans what the main loop asked for
+    TB1R = 0 - edges_set;
+    edges_run = edges_set;
+
+    // a stamp from before a gap is too old, TB0 may have wrapped since
+    if (primed && tick - prev_tick <= TRACK_GAP_TICKS
+        && (unsigned char)(ring_head - ring_tail) < SIZE_TRACK_RING)
+    {
+        struct track_stamp *s = &ring[ring_head & TRACK_RING_MASK];
+
+        s->dt    = t - prev_t;
+        s->edges = edges;
+        ring_head++;
+    }
+    primed    = 1;
+    prev_t    = t;
+    prev_tick = tick;
+}
+
+
+// Estimate the pitch of the new stamps and send what changed
+void trackService(void)
+{
+    unsigned char fresh = 0;
+    unsigned int  last;
+    unsigned long per;
+    unsigned long edges;
+    int pitch, dev;
+
+    if (!f_track) trackStart();
+
+    while (ring_tail != ring_head)
+    {
+        struct track_stamp *s = &ring[ring_tail & TRACK_RING_MASK];
+
+        hist[2] = hist[1];
+        hist[1] = hist[0];
+        hist[0] = ((unsigned long)s->dt << 4) / s->edges;
+        if (n_hist < 3) n_hist++;
+        ring_tail++;
+        fresh = 1;
+    }
+
+    // no edges for a while, read before ctrl_ticks so it is never ahead
+    last = prev_tick;
+    if (ctrl_ticks - last > TRACK_GAP_TICKS)
+    {
+        n_hist    = 0;
+        edges_set = 1;
+        trackOff();
+        return;
+    }
+    if (!fresh || n_hist < 3) return;
+
+    per = trackMedian();
+
+    // stamps at least TRACK_MIN_CNT apart
+    edges = ((unsigned long)TRACK_MIN_CNT << 4) / per + 1;
+    edges_set = (edges > TRACK_MAX_EDGES) ? TRACK_MAX_EDGES : (unsigned char)edges;
+
+    pitch = trackPitch(per);
+    if (pitch < 0)
+    {
+        trackOff();
+        return;
+    }
+
+    // a new note past the hysteresis, otherwise bend the one that is on
+    dev = pitch - ((track_note == TRACK_NONE) ? 0 : (int)track_note * 256);
+    if (track_note == TRACK_NONE || dev > 128 + TRACK_HYST || dev < -128 - TRACK_HYST)
+    {
+        unsigned char note = (pitch + 128) >> 8;
+        trackNote(note, pitch - (int)note * 256);
+    }
+    else if (ctrl_ticks != bend_tick && (dev - sent_dev > TRACK_BEND_STEP || sent_dev - dev > TRACK_BEND_STEP))
+    {
+        trackBend(dev);
+    }
+}
+
+
+// Next byte of the outgoing messages, -1 if none
+int trackTxNext(void)
+{
+    unsigned char byte;
+
+    if (tx_tail == tx_head) return -1;
+
+    byte = tx_q[tx_tail & TRACK_TX_MASK].b[tx_pos];
+    if (++tx_pos == 3)
+    {
+        tx_pos = 0;
+        tx_tail++;
+    }
+    return byte;
+}
+
+
+// 1 while a message is part sent
+unsigned char trackTxBusy(void)
+{
+    return tx_pos != 0;
+}
+
+
+#endif
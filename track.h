@@ -0,0 +1,81 @@
+/*
+ * track.h
+ *
+ * Pitch to MIDI from the edges on TB1CLK, PITCH_TRACK build only
+ *
+ */
+
+#ifndef TRACK_H_
+#define TRACK_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define TRACK_CLK_FREQ      (SMCLK_FREQ / 16)       // edge time base on TB0, 1 MHz at 16 MHz
+#define TRACK_LOW_NOTE      24                      // C1, the longest period fits a TB0 rollover
+#define TRACK_HIGH_NOTE     108                     // C8
+#define TRACK_MIN_CNT       (TRACK_CLK_FREQ / 5000) // TB0 counts between stamps at least, 5000 interrupts/s at most
+#define TRACK_MAX_EDGES     64                      // edges per stamp at most
+#define TRACK_GAP_TICKS     40                      // control ticks without a stamp before the signal is gone
+#define TRACK_HYST          38                      // 1/256 semitone past halfway (15 cents) before the note changes
+#define TRACK_BEND_STEP     3                       // 1/256 semitone (1.2 cents) of change before a new bend is sent
+#define TRACK_BEND_RANGE    2                       // bend range of the receiving synth in semitones
+#define TRACK_VELOCITY      100
+#define TRACK_NONE          0xFF                    // track_note while no note is on
+
+#define SIZE_TRACK_RING     8                       // stamps, must be a power of 2
+#define TRACK_RING_MASK     (SIZE_TRACK_RING - 1)
+#define SIZE_TRACK_TX       8                       // messages, must be a power of 2
+#define TRACK_TX_MASK       (SIZE_TRACK_TX - 1)
+
+#if (SMCLK_FREQ / 16000) * TRACK_GAP_TICKS > 65535
+  #error TRACK_GAP_TICKS must stay below a TB0 rollover
+#endif
+
+
+
+//******************************************************************************
+// Structures ******************************************************************
+//******************************************************************************
+
+// one stamp from Timer1_B1_ISR
+struct track_stamp {
+    unsigned int dt;                            // TB0 counts since the last stamp
+    unsigned char edges;                        // edges they span
+};
+
+// one outgoing channel message, always sent with its status byte
+struct track_msg {
+    unsigned char b[3];
+};
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern volatile unsigned char f_track;          // the tracker owns the frequency counter
+extern unsigned char track_note;                // note sent, TRACK_NONE while none is on
+extern unsigned int track_drops;                // messages dropped on a full TX queue
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void trackStart(void);                                  // Take the frequency counter and start stamping edges
+void trackStop(void);                                   // Note off and hand the frequency counter back
+void trackEdge(void);                                   // Stamp the edges just counted, from Timer1_B1_ISR
+void trackService(void);                                // Estimate the pitch of the new stamps and send what changed
+int trackTxNext(void);                                  // Next byte of the outgoing messages, -1 if none
+unsigned char trackTxBusy(void);                        // 1 while a message is part sent
+
+
+#endif /* TRACK_H_ */
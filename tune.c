@@ -0,0 +1,38 @@
+/*
+ * tune.c
+ *
+ * The start-up tune moves the EXP FREQ offset one DAC step per measurement
+ * until one period of note 0 is CNT_AT_0V tune clocks, then the EXP SCALE
+ * one step per measurement until one period of A4 is CNT_AT_440. The
+ * decisions live here so tools/tune_bench.c runs exactly what the firmware
+ * runs, built for the host.
+ *
+ */
+
+#include <tune.h>
+#include <mcu_vco.h>
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// EXP FREQ offset step for a note 0 count, 0 when in tune
+signed char tuneOffsetStep(unsigned int t_meas)
+{
+    if (t_meas < CNT_AT_0V + CNT_AT_0V_TOL && t_meas > CNT_AT_0V - CNT_AT_0V_TOL) return 0;
+
+    // long period means the VCO is flat, raise the offset
+    return (t_meas > CNT_AT_0V) ? 1 : -1;
+}
+
+
+// EXP SCALE step for an A4 count, 0 when in tune
+signed char tuneScaleStep(unsigned int t_meas)
+{
+    if (t_meas < CNT_AT_440 + TUNE_FREQ_TOL && t_meas > CNT_AT_440 - TUNE_FREQ_TOL) return 0;
+
+    // short period means the scale is too wide, raising the DAC narrows it
+    return (t_meas < CNT_AT_440) ? 1 : -1;
+}
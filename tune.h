@@ -0,0 +1,32 @@
+/*
+ * tune.h
+ *
+ * Decisions of the start-up tune, shared by main.c and tools/tune_bench.c
+ *
+ */
+
+#ifndef TUNE_H_
+#define TUNE_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define TUNE_FLOOR_HZ     4         // lowest VCO frequency a tune measurement waits for
+#define TUNE_TIMEOUT      ((NUM_IGNORED + 2) * CTRL_TICK_HZ / TUNE_FLOOR_HZ)   // control ticks for the periods of one measurement at TUNE_FLOOR_HZ
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+signed char tuneOffsetStep(unsigned int t_meas);        // EXP FREQ offset step for a note 0 count, 0 when in tune
+signed char tuneScaleStep(unsigned int t_meas);         // EXP SCALE step for an A4 count, 0 when in tune
+
+
+#endif /* TUNE_H_ */
@@ -0,0 +1,163 @@
+/*
+ * verify.c
+ *
+ * The sweep plays every note of dac_lut with the output muted, measures it
+ * with the TB0/TB1 frequency counter and reports the error against
+ * conv_midi_to_freq in 0.1 cent on the debug terminal, then the worst note and
+ * the sweep time. It runs after every full tune and on 'v'.
+ *
+ * Settling and measuring are pipelined: Timer1_B1_ISR moves the DAC on to the
+ * next note the moment a measurement ends, so the VCO settles while the main
+ * loop reports the note just measured, and only VERIFY_IGNORED periods are
+ * thrown away instead of the five of the start-up tune. Each note is counted
+ * over as many periods as fit VERIFY_GATE_CNT, so a sweep takes about
+ * 121 x 62.5 ms plus the long periods of the bottom octaves.
+ *
+ * The counter needs the VCO running, so HARD SYNC is released for the sweep
+ * and set again at the end. A tune request that cuts the sweep short leaves
+ * HARD SYNC to the tune.
+ *
+ */
+
+#include <mcu_vco.h>
+#include <verify.h>
+#include <midi_luts.h>
+#include <retune.h>
+
+#if PITCH_VERIFY == 1
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+volatile unsigned char f_verify = 0;
+volatile unsigned char f_verify_request = 0;
+unsigned int verify_next_dac = 0;
+
+static unsigned char note;              // note being measured
+static unsigned char worst_note;
+static int worst_err;                   // 0.1 cent, signed error of worst_note
+static int worst_mag;                   // its magnitude
+static unsigned char skipped;           // notes without a result
+static unsigned int sweep_start;        // ctrl_ticks at the start
+static unsigned int meas_start;         // ctrl_ticks when the running measurement started
+
+// state owned by main.c
+extern volatile unsigned int ctrl_ticks;
+extern unsigned int t_meas;
+extern unsigned char num_ignored;
+extern char debug_msg[SIZE_MESSAGE];
+
+
+
+//******************************************************************************
+// Functions *******************************************************************
+//******************************************************************************
+
+// Wait for the previous line to go out before debug_msg is written again
+static void verifyWait(void)
+{
+    while (UCA1IE & UCTXIE);
+}
+
+
+// Start measuring the current note, the DAC is already on it
+static void verifyMeasure(void)
+{
+    meas_periods = VERIFY_GATE_CNT / retuneTargetCount(note);
+    if (meas_periods == 0) meas_periods = 1;
+
+    verify_next_dac = conv_midi_to_dac((note < VERIFY_LAST) ? note + 1 : note);
+    meas_start  = ctrl_ticks;
+    num_ignored = NUM_IGNORED - VERIFY_IGNORED;
+    f_verify = 2;
+    initFreqCtr();
+}
+
+
+// Report the sweep and leave the output muted at note 0
+static void verifyDone(void)
+{
+    verifyWait();
+    sprintf(debug_msg, "V WORST N = %d E = %d\r\n", worst_note, worst_err);
+    UCA1IE |= UCTXIE;
+    verifyWait();
+    sprintf(debug_msg, "V SKIP %d TIME %d ms\r\n", skipped, ctrl_ticks - sweep_start);
+    UCA1IE |= UCTXIE;
+
+    SET_DAC0(0);
+    HARD_SYNC_ON;
+    f_verify = 0;
+}
+
+
+// Next note, or the end of the sweep
+static void verifyNext(void)
+{
+    if (note == VERIFY_LAST)
+    {
+        verifyDone();
+        return;
+    }
+    note++;
+    verifyMeasure();
+}
+
+
+// Run one step of the sweep from the main loop
+void verifyService(void)
+{
+    switch (f_verify)
+    {
+        case 1:  // start at the bottom
+            note       = VERIFY_FIRST;
+            worst_note = VERIFY_FIRST;
+            worst_err  = 0;
+            worst_mag  = 0;
+            skipped    = 0;
+            sweep_start = ctrl_ticks;
+            HARD_SYNC_OFF;              // the counter needs edges
+            SET_DAC0(conv_midi_to_dac(note));
+            verifyMeasure();
+            break;
+
+        case 2:  // wait to start measuring
+        case 4:  // wait until measurement complete
+            if (ctrl_ticks - meas_start < VERIFY_TIMEOUT) break;
+
+            // no edges from the VCO, skip the note
+            retuneAbort();
+            skipped++;
+            verifyWait();
+            sprintf(debug_msg, "V N = %d NO SIGNAL\r\n", note);
+            UCA1IE |= UCTXIE;
+            SET_DAC0(verify_next_dac);
+            verifyNext();
+            break;
+
+        case 8:  // report the note, the DAC has moved on already
+        {
+            int err = retuneCents(note, meas_periods, t_meas);
+            int mag = (err < 0) ? -err : err;
+
+            if (mag > worst_mag)
+            {
+                worst_mag  = mag;
+                worst_err  = err;
+                worst_note = note;
+            }
+            verifyWait();
+            sprintf(debug_msg, "V N = %d E = %d\r\n", note, err);
+            UCA1IE |= UCTXIE;
+            verifyNext();
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+#endif
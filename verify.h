@@ -0,0 +1,44 @@
+/*
+ * verify.h
+ *
+ * Pitch verification sweep over every playable note, PITCH_VERIFY build only
+ *
+ */
+
+#ifndef VERIFY_H_
+#define VERIFY_H_
+
+#include <msp430.h>
+#include <cfg.h>
+
+
+//******************************************************************************
+// Constants *******************************************************************
+//******************************************************************************
+
+#define VERIFY_FIRST        0                       // notes swept, the range of dac_lut
+#define VERIFY_LAST         120
+#define VERIFY_GATE_CNT     (TUNE_CLK_FREQ / 16)    // tune clock counts per note (62.5 ms, 0.1 cent)
+#define VERIFY_IGNORED      2                       // periods ignored per note, the DAC moved a measurement earlier
+#define VERIFY_TIMEOUT      1000                    // control ticks without a result before a note is skipped
+
+
+
+//******************************************************************************
+// Global Variables ************************************************************
+//******************************************************************************
+
+extern volatile unsigned char f_verify;         // sweep flag, 1 starts it, advanced by Timer1_B1_ISR
+extern volatile unsigned char f_verify_request; // 'v' on the debug terminal
+extern unsigned int verify_next_dac;            // DAC value Timer1_B1_ISR sets once a measurement ends
+
+
+
+//******************************************************************************
+// Function Definitions ********************************************************
+//******************************************************************************
+
+void verifyService(void);                               // Run one step of the sweep from the main loop
+
+
+#endif /* VERIFY_H_ */